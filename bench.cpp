@@ -0,0 +1,438 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "fileio.h"
+#include "huffman.h"
+#include "lz77.h"
+#include "lz78.h"
+#include "lzw.h"
+
+/*
+ * 吞吐量基准测试
+ *
+ * 对每个输入、每种算法与参数、每个线程数，分别计时压缩与解压（墙钟时间，steady_clock），重复多次，
+ * 报告压缩率、各自的最小值/中位数/p99耗时与MB/s（按中位数计算，以原始数据长度为准）。
+ * 计时只包括内存中的编解码与序列化，不包括文件读写。结果打印到标准输出，并可以写成CSV或JSON以便跟踪。
+ */
+
+using namespace std;
+
+#define putline(x) printf("%s\n", x)
+
+int n_reps = 5;                        // 每项重复次数
+vector<int> thread_counts = {1, 2, 4}; // 并行算法使用的线程数
+size_t synthetic_size = 4 << 20;       // 合成输入的长度
+vector<string> input_files = {"data/intro.txt", "data/train.txt"};
+const char *csv_file = NULL;
+const char *json_file = NULL;
+unsigned seed = 0;
+
+void show_usage() {
+    putline("-r; --reps    repetitions per case. (5)");
+    putline("-t; --threads comma separated thread counts for parallel codecs. (1,2,4)");
+    putline("--size        length of each synthetic input in bytes. (4194304)");
+    putline("--files       comma separated input files, missing ones are skipped. (data/intro.txt,data/train.txt)");
+    putline("--csv         write results as CSV to this file.");
+    putline("--json        write results as JSON to this file.");
+    putline("-s; --seed    random seed of synthetic inputs. (0)");
+    exit(0);
+}
+
+void unknown_arg_err() {
+    putline("Unknown argument error");
+    show_usage();
+}
+
+/*
+ * 按逗号拆分字符串。
+ */
+vector<string> split(const char *s) {
+    vector<string> parts;
+    string cur;
+    for (; *s; s++) {
+        if (*s == ',') {
+            parts.push_back(cur);
+            cur.clear();
+        } else {
+            cur += *s;
+        }
+    }
+    parts.push_back(cur);
+    return parts;
+}
+
+#define smatch(a,b)     !strcmp(a,b)
+
+/*
+ * 解析命令行参数。
+ */
+void parse_arg(int argc, char *argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        char *arg = argv[i];
+        bool hasNext = i + 1 < argc;
+        if ((smatch(arg, "-r") || smatch(arg, "--reps")) && hasNext) n_reps = max(1, atoi(argv[++i]));
+        else if ((smatch(arg, "-t") || smatch(arg, "--threads")) && hasNext) {
+            thread_counts.clear();
+            for (const string &t : split(argv[++i]))
+                thread_counts.push_back(max(1, atoi(t.c_str())));
+        }
+        else if (smatch(arg, "--size") && hasNext) synthetic_size = atoll(argv[++i]);
+        else if (smatch(arg, "--files") && hasNext) input_files = split(argv[++i]);
+        else if (smatch(arg, "--csv") && hasNext) csv_file = argv[++i];
+        else if (smatch(arg, "--json") && hasNext) json_file = argv[++i];
+        else if ((smatch(arg, "-s") || smatch(arg, "--seed")) && hasNext) seed = atoi(argv[++i]);
+        else if (smatch(arg, "-h") || smatch(arg, "--help")) show_usage();
+        else unknown_arg_err();
+    }
+}
+
+/*
+ * 合成文本：从随机生成的词表中按近似Zipf分布取词，夹杂标点与换行。
+ */
+vector<char> gen_text(size_t len, mt19937 &rng) {
+    vector<string> words(4000);
+    for (string &w : words) {
+        int n = 2 + rng() % 9;
+        for (int i = 0; i < n; i++)
+            w += 'a' + rng() % 26;
+    }
+    uniform_real_distribution<double> u(0, 1);
+    vector<char> out;
+    while (out.size() < len) {
+        const string &w = words[(size_t)(words.size() * pow(u(rng), 3))]; // 小下标的词出现得多
+        out.insert(out.end(), w.begin(), w.end());
+        int r = rng() % 20;
+        out.push_back(r == 0 ? '\n' : r == 1 ? ',' : r == 2 ? '.' : ' ');
+    }
+    out.resize(len);
+    return out;
+}
+
+/*
+ * 合成二进制数据：均匀随机字节，几乎不可压缩。
+ */
+vector<char> gen_binary(size_t len, mt19937 &rng) {
+    vector<char> out(len);
+    for (char &c : out)
+        c = rng();
+    return out;
+}
+
+/*
+ * 合成重复数据：大部分是对之前任意位置的长段复制，少量字节被随机改写。
+ */
+vector<char> gen_repetitive(size_t len, mt19937 &rng) {
+    vector<char> out;
+    for (int i = 0; i < 4096; i++)
+        out.push_back(rng());
+    while (out.size() < len) {
+        size_t from = rng() % out.size(), n = 64 + rng() % 4096;
+        for (size_t i = 0; i < n; i++)
+            out.push_back(rng() % 100 ? out[from + i] : (char)rng());
+    }
+    out.resize(len);
+    return out;
+}
+
+/*
+ * 一项测试：compress压缩输入并返回压缩后的字节数，decompress将上次压缩的结果解压到out。
+ * 两个函数共享的中间结果由调用者在闭包中持有。
+ */
+struct BenchCase {
+    string method;
+    string params;
+    int threads;
+    function<size_t(const vector<char> &src)> compress;
+    function<void(vector<char> &out)> decompress;
+};
+
+/*
+ * 一组耗时的统计量，单位为毫秒。
+ */
+struct Timing {
+    double min, median, p99;
+};
+
+struct BenchResult {
+    string input;
+    size_t inputSize;
+    string method, params;
+    int threads;
+    double ratio; // 压缩后长度 / 原始长度
+    Timing comp, decomp;
+    bool ok;
+};
+
+static inline double now_ms() {
+    return chrono::duration<double, milli>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Timing summarize(vector<double> t) {
+    sort(t.begin(), t.end());
+    size_t p99 = (size_t)ceil(t.size() * 0.99) - 1; // 最近秩法
+    return Timing{t.front(), t[t.size() / 2], t[min(p99, t.size() - 1)]};
+}
+
+double mbps(size_t bytes, double ms) {
+    return ms > 0 ? bytes / 1e6 / (ms / 1e3) : 0;
+}
+
+/*
+ * 生成全部测试项：各算法的典型参数组合，并行算法对每个线程数各测一次。
+ */
+vector<BenchCase> make_cases() {
+    vector<BenchCase> cases;
+    const int blockSize = 1 << 20;
+
+    for (auto sl : {make_pair(4095, 255), make_pair(32767, 258)}) {
+        int sb = sl.first, lb = sl.second;
+        auto units = make_shared<vector<Lz77OutputUnit>>();
+        cases.push_back({"lz77", "sb=" + to_string(sb) + " lb=" + to_string(lb), 1,
+            [=](const vector<char> &src) {
+                units->clear();
+                compressLz77(src, *units, sb, lb);
+                return units->size() * Lz77OutputUnit::SIZE;
+            },
+            [=](vector<char> &out) { decompressLz77(*units, out, sb, lb); }});
+    }
+
+    // 压缩等级只改变查找与选择匹配的方式，各等级的压缩率与速度见此
+    for (int level : {1, 3, 6, 9}) {
+        int sb = 32767, lb = 258;
+        auto units = make_shared<vector<Lz77OutputUnit>>();
+        cases.push_back({"lz77", "sb=32767 lb=258 level=" + to_string(level), 1,
+            [=](const vector<char> &src) {
+                units->clear();
+                compressLz77(src, *units, sb, lb, lz77Level(level));
+                return units->size() * Lz77OutputUnit::SIZE;
+            },
+            [=](vector<char> &out) { decompressLz77(*units, out, sb, lb); }});
+    }
+
+    {
+        int sb = 32767, lb = 258;
+        auto units = make_shared<vector<Lz77OutputUnit>>();
+        auto coded = make_shared<vector<char>>();
+        cases.push_back({"lz77+huffman", "sb=32767 lb=258", 1,
+            [=](const vector<char> &src) {
+                units->clear();
+                coded->clear();
+                compressLz77(src, *units, sb, lb);
+                return (size_t)huffmanEncodeLz77(units->data(), units->size(), *coded);
+            },
+            [=](vector<char> &out) {
+                units->clear();
+                huffmanDecodeLz77(coded->data(), coded->size(), *units);
+                decompressLz77(*units, out, sb, lb);
+            }});
+    }
+
+    for (int t : thread_counts) {
+        auto result = make_shared<Lz77ParallelResult>();
+        auto srcLen = make_shared<size_t>(0);
+        cases.push_back({"lz77-parallel", "sb=32767 lb=258 bs=1M", t,
+            [=](const vector<char> &src) {
+                Lz77Options options;
+                options.blockSize = blockSize;
+                *result = Lz77ParallelResult();
+                parallel_compressLz77(t, src, *result, 32767, 258, options);
+                *srcLen = src.size();
+                size_t n = sizeof(int) * (2 + result->lens.size() * 2);
+                for (int len : result->lens)
+                    n += (size_t)len * Lz77OutputUnit::SIZE;
+                return n;
+            },
+            [=](vector<char> &out) {
+                out.resize(*srcLen);
+                parallel_decompressLz77(t, *result, out.data(), out.size());
+            }});
+    }
+
+    for (int ds : {4095, 32767, 1 << 20}) {
+        auto units = make_shared<vector<Lz78OutputUnit>>();
+        auto packed = make_shared<vector<char>>();
+        cases.push_back({"lz78", "ds=" + to_string(ds), 1,
+            [=](const vector<char> &src) {
+                units->clear();
+                packed->clear();
+                compressLz78(src, *units, ds);
+                return (size_t)packLz78(units->data(), units->size(), ds, *packed);
+            },
+            [=](vector<char> &out) {
+                units->clear();
+                unpackLz78(packed->data(), packed->size(), ds, *units);
+                decompressLz78(*units, out, ds);
+            }});
+
+        auto unitsW = make_shared<vector<LzWOutputUnit>>();
+        auto packedW = make_shared<vector<char>>();
+        cases.push_back({"lzw", "ds=" + to_string(ds), 1,
+            [=](const vector<char> &src) {
+                unitsW->clear();
+                packedW->clear();
+                compressLzW(src, *unitsW, ds);
+                return (size_t)packLzW(unitsW->data(), unitsW->size(), ds, *packedW);
+            },
+            [=](vector<char> &out) {
+                unitsW->clear();
+                unpackLzW(packedW->data(), packedW->size(), ds, *unitsW);
+                decompressLzW(*unitsW, out, ds);
+            }});
+    }
+
+    for (int t : thread_counts) {
+        const int ds = 32767;
+        // 单个LZ78流，按短语长度的前缀和并行解压
+        auto units = make_shared<vector<Lz78OutputUnit>>();
+        cases.push_back({"lz78-stream-decode", "ds=32767", t,
+            [=](const vector<char> &src) {
+                units->clear();
+                compressLz78(src, *units, ds);
+                vector<char> packed;
+                return (size_t)packLz78(units->data(), units->size(), ds, packed);
+            },
+            [=](vector<char> &out) { parallel_decompressLz78Stream(t, units->data(), units->size(), out, ds); }});
+
+        // 分块并行，各块独立的字典
+        auto blocks78 = make_shared<LzBlockResult>();
+        auto blocksW = make_shared<LzBlockResult>();
+        auto srcLen = make_shared<size_t>(0);
+        auto blockBytes = [](const LzBlockResult &r) {
+            size_t n = sizeof(int) * (1 + r.rawLens.size() * 2);
+            for (auto &v : r.packed)
+                n += v.size();
+            return n;
+        };
+        cases.push_back({"lz78-parallel", "ds=32767 bs=1M", t,
+            [=](const vector<char> &src) {
+                parallel_compressLz78(t, src.data(), src.size(), *blocks78, ds, blockSize);
+                *srcLen = src.size();
+                return blockBytes(*blocks78);
+            },
+            [=](vector<char> &out) {
+                out.resize(*srcLen);
+                parallel_decompressLz78(t, *blocks78, out.data(), out.size(), ds);
+            }});
+        cases.push_back({"lzw-parallel", "ds=32767 bs=1M", t,
+            [=](const vector<char> &src) {
+                parallel_compressLzW(t, src.data(), src.size(), *blocksW, ds, blockSize);
+                *srcLen = src.size();
+                return blockBytes(*blocksW);
+            },
+            [=](vector<char> &out) {
+                out.resize(*srcLen);
+                parallel_decompressLzW(t, *blocksW, out.data(), out.size(), ds);
+            }});
+    }
+    return cases;
+}
+
+BenchResult run_case(const string &name, const vector<char> &src, BenchCase &c) {
+    vector<double> compTimes, decompTimes;
+    size_t compressed = 0;
+    bool ok = true;
+    vector<char> out;
+    for (int r = 0; r < n_reps; r++) {
+        double start = now_ms();
+        compressed = c.compress(src);
+        compTimes.push_back(now_ms() - start);
+
+        out.clear();
+        start = now_ms();
+        c.decompress(out);
+        decompTimes.push_back(now_ms() - start);
+        ok = ok && out == src;
+    }
+    return BenchResult{name, src.size(), c.method, c.params, c.threads,
+                       src.empty() ? 0 : (double)compressed / src.size(), summarize(compTimes), summarize(decompTimes), ok};
+}
+
+void write_csv(const char *path, const vector<BenchResult> &results) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        printf("Cannot write %s\n", path);
+        return;
+    }
+    fprintf(f, "input,size,method,params,threads,ratio,comp_min_ms,comp_median_ms,comp_p99_ms,comp_mbps,"
+               "decomp_min_ms,decomp_median_ms,decomp_p99_ms,decomp_mbps,ok\n");
+    for (const BenchResult &r : results)
+        fprintf(f, "%s,%zu,%s,%s,%d,%.4f,%.3f,%.3f,%.3f,%.2f,%.3f,%.3f,%.3f,%.2f,%d\n",
+                r.input.c_str(), r.inputSize, r.method.c_str(), r.params.c_str(), r.threads, r.ratio,
+                r.comp.min, r.comp.median, r.comp.p99, mbps(r.inputSize, r.comp.median),
+                r.decomp.min, r.decomp.median, r.decomp.p99, mbps(r.inputSize, r.decomp.median), r.ok);
+    fclose(f);
+}
+
+void write_json(const char *path, const vector<BenchResult> &results) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        printf("Cannot write %s\n", path);
+        return;
+    }
+    fprintf(f, "[\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult &r = results[i];
+        fprintf(f, "  {\"input\": \"%s\", \"size\": %zu, \"method\": \"%s\", \"params\": \"%s\", \"threads\": %d, \"ratio\": %.4f, "
+                   "\"compress\": {\"min_ms\": %.3f, \"median_ms\": %.3f, \"p99_ms\": %.3f, \"mbps\": %.2f}, "
+                   "\"decompress\": {\"min_ms\": %.3f, \"median_ms\": %.3f, \"p99_ms\": %.3f, \"mbps\": %.2f}, \"ok\": %s}%s\n",
+                r.input.c_str(), r.inputSize, r.method.c_str(), r.params.c_str(), r.threads, r.ratio,
+                r.comp.min, r.comp.median, r.comp.p99, mbps(r.inputSize, r.comp.median),
+                r.decomp.min, r.decomp.median, r.decomp.p99, mbps(r.inputSize, r.decomp.median),
+                r.ok ? "true" : "false", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(f, "]\n");
+    fclose(f);
+}
+
+int main(int argc, char *argv[]) {
+    parse_arg(argc, argv);
+
+    // 准备输入：给定的文件（不存在时跳过）与三种合成数据
+    vector<pair<string, vector<char>>> inputs;
+    for (const string &path : input_files) {
+        MappedFile file;
+        if (!file.open(path.c_str())) {
+            printf("Skip %s (cannot open)\n", path.c_str());
+            continue;
+        }
+        inputs.push_back({path, vector<char>(file.data(), file.data() + file.size())});
+    }
+    mt19937 rng(seed);
+    inputs.push_back({"synthetic-text", gen_text(synthetic_size, rng)});
+    inputs.push_back({"synthetic-binary", gen_binary(synthetic_size, rng)});
+    inputs.push_back({"synthetic-repetitive", gen_repetitive(synthetic_size, rng)});
+
+    vector<BenchCase> cases = make_cases();
+    vector<BenchResult> results;
+    printf("%-22s %-20s %-22s %3s %7s %10s %10s %10s %10s %s\n", "input", "method", "params", "thr", "ratio",
+           "comp MB/s", "p99 ms", "decomp MB/s", "p99 ms", "");
+    for (auto &input : inputs) {
+        for (BenchCase &c : cases) {
+            BenchResult r = run_case(input.first, input.second, c);
+            printf("%-22s %-20s %-22s %3d %7.4f %10.2f %10.3f %10.2f %10.3f %s\n", r.input.c_str(), r.method.c_str(),
+                   r.params.c_str(), r.threads, r.ratio, mbps(r.inputSize, r.comp.median), r.comp.p99,
+                   mbps(r.inputSize, r.decomp.median), r.decomp.p99, r.ok ? "" : "FAILED");
+            fflush(stdout);
+            results.push_back(r);
+        }
+    }
+
+    if (csv_file)
+        write_csv(csv_file, results);
+    if (json_file)
+        write_json(json_file, results);
+
+    for (const BenchResult &r : results)
+        if (!r.ok)
+            return 1;
+    return 0;
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/*
+ * 按位读写
+ *
+ * 位流按小端顺序排列：先写入的位位于字节的低位。读写时以64位整数为缓冲，
+ * 每次从内存中整块读入或写出，避免逐位、逐字节的操作。
+ */
+
+/*
+ * 表示非负整数v所需的位数，v为0时返回0。
+ */
+static inline int bitWidth(uint32_t v) {
+    return v ? 32 - __builtin_clz(v) : 0;
+}
+
+/*
+ * 位写入器，将位流追加到一个vector<char>末尾。
+ */
+class BitWriter {
+public:
+    BitWriter(std::vector<char> &out) : out(out), acc(0), bits(0) {}
+
+    /*
+     * 写入value的低n位，n不超过32。
+     */
+    void put(uint32_t value, int n) {
+        acc |= (uint64_t)value << bits;
+        bits += n;
+        if (bits >= 32) {
+            char buf[4];
+            uint32_t low = (uint32_t)acc;
+            std::memcpy(buf, &low, 4);
+            out.insert(out.end(), buf, buf + 4);
+            acc >>= 32;
+            bits -= 32;
+        }
+    }
+
+    /*
+     * 写出缓冲中剩余的位，不足一字节的部分以0补齐。
+     */
+    void flush() {
+        while (bits > 0) {
+            out.push_back((char)acc);
+            acc >>= 8;
+            bits -= 8;
+        }
+        acc = 0;
+        bits = 0;
+    }
+
+private:
+    std::vector<char> &out;
+    uint64_t acc; // 尚未写出的位
+    int bits;     // acc中有效的位数
+};
+
+/*
+ * 位读取器，从[buf, buf + len)中读取位流。读到末尾之后的位均视为0，调用者可通过overrun检查是否读过了头。
+ */
+class BitReader {
+public:
+    BitReader(const char *buf, size_t len) : p(buf), end(buf + len), acc(0), bits(0), over(0) { refill(); }
+
+    /*
+     * 保证缓冲中至少有57位（输入足够时）。
+     */
+    void refill() {
+        if (end - p >= 8) {
+            uint64_t v;
+            std::memcpy(&v, p, 8);
+            acc |= v << bits;
+            p += (63 - bits) >> 3;
+            bits |= 56;
+        } else {
+            while (bits <= 56) {
+                if (p < end) {
+                    acc |= (uint64_t)(unsigned char)*p++ << bits;
+                } else {
+                    over += 8;
+                }
+                bits += 8;
+            }
+        }
+    }
+
+    /*
+     * 返回接下来的n位但不移动读取位置，n不超过缓冲中的位数。
+     */
+    uint32_t peek(int n) const { return (uint32_t)(acc & ((1ull << n) - 1)); }
+
+    void skip(int n) {
+        acc >>= n;
+        bits -= n;
+    }
+
+    /*
+     * 读取n位，n不超过32。
+     */
+    uint32_t get(int n) {
+        if (bits < n)
+            refill();
+        uint32_t v = peek(n);
+        skip(n);
+        return v;
+    }
+
+    /*
+     * 是否读取了超过输入末尾的位。
+     */
+    bool overrun() const { return bits < over; }
+
+private:
+    const char *p;
+    const char *end;
+    uint64_t acc; // 已读入但尚未消耗的位
+    int bits;     // acc中有效的位数
+    int over;     // acc中由于输入结束而补上的0的位数
+};
@@ -0,0 +1,138 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "stats.h"
+#include "threadpool.h"
+
+/*
+ * LZ78/LZW的分块并行编码
+ *
+ * 输入按固定长度分块，各块使用独立的字典，由线程池中的线程分别压缩并按位打包。块的划分与线程数无关，
+ * 任何线程数下输出都相同。解压时各块的输出长度已知，每块直接解压到输出中的最终位置。
+ */
+
+/*
+ * 分块并行压缩结果
+ */
+struct LzBlockResult {
+    std::vector<int> rawLens;              // 各块解压后的长度
+    std::vector<std::vector<char>> packed; // 各块按位打包后的输出单元
+};
+
+/*
+ * 以下模板由lz78.cpp与lzw.cpp实例化。Context为对应的编解码上下文，Unit为输出单元，
+ * LzBlockCodec给出对应的按位打包函数。
+ */
+template <class Unit>
+struct LzBlockCodec {
+    int (*pack)(const Unit *src, int srcLen, int dictSize, std::vector<char> &out);
+    int (*unpack)(const char *buf, size_t bufLen, int dictSize, std::vector<Unit> &dst);
+};
+
+template <class Context, class Unit>
+struct LzBlockJob {
+    LzBlockCodec<Unit> codec;
+    int dictSize;
+    const char *src; // 压缩时为输入
+    int srcLen;
+    int blockSize;
+    char *dst;       // 解压时为输出
+    std::vector<long long> offsets; // 解压时各块在输出中的起始位置，最后一项为总长度
+    LzBlockResult *result;
+    const LzBlockResult *input;
+    std::vector<Context> contexts;  // 每个线程一个，复用字典
+    std::vector<std::vector<Unit>> units;  // 每个线程的输出单元缓冲
+    std::atomic<bool> failed;
+
+    LzBlockJob(LzBlockCodec<Unit> codec, int dictSize, int nThreads)
+            : codec(codec), dictSize(dictSize), contexts(nThreads, Context(dictSize)), units(nThreads), failed(false) {}
+};
+
+template <class Context, class Unit>
+static void compressLzBlock(void *arg, int i, int worker) {
+    LzBlockJob<Context, Unit> *job = (LzBlockJob<Context, Unit> *)arg;
+    STAT(uint64_t t0 = lzStatsNow();)
+    long long offset = (long long)job->blockSize * i;
+    int len = std::min<long long>(job->srcLen - offset, job->blockSize);
+    std::vector<Unit> &units = job->units[worker];
+    units.clear();
+    job->contexts[worker].compress(job->src + offset, len, units);
+    job->codec.pack(units.data(), units.size(), job->dictSize, job->result->packed[i]);
+    job->result->rawLens[i] = len;
+    STAT(lzStatsBlock(lzStatsNow() - t0, len);)
+}
+
+template <class Context, class Unit>
+static void decompressLzBlock(void *arg, int i, int worker) {
+    LzBlockJob<Context, Unit> *job = (LzBlockJob<Context, Unit> *)arg;
+    STAT(uint64_t t0 = lzStatsNow();)
+    const std::vector<char> &packed = job->input->packed[i];
+    std::vector<Unit> &units = job->units[worker];
+    units.clear();
+    if (job->codec.unpack(packed.data(), packed.size(), job->dictSize, units) < 0) {
+        job->failed = true;
+        return;
+    }
+    // 直接解压到本块在输出中的位置，超出本块的长度时在写入前即失败
+    long long start = job->offsets[i], len = job->offsets[i + 1] - start;
+    if (job->contexts[worker].decompress(units.data(), units.size(), job->dst + start, len) != len) {
+        job->failed = true;
+        return;
+    }
+    STAT(lzStatsBlock(lzStatsNow() - t0, len);)
+}
+
+/*
+ * 分块并行压缩。
+ *
+ * Returns:
+ *     返回块数。
+ */
+template <class Context, class Unit>
+int parallelCompressLzBlocks(int num_t, const char *src, int srcLen, LzBlockResult &dst, int dictSize, int blockSize, LzBlockCodec<Unit> codec) {
+    if (blockSize <= 0)
+        blockSize = srcLen > 0 ? srcLen : 1;
+    int n_block = std::max(1, (int)(((long long)srcLen + blockSize - 1) / blockSize));
+    dst.rawLens.assign(n_block, 0);
+    dst.packed.assign(n_block, std::vector<char>());
+
+    ThreadPool &pool = ThreadPool::shared(num_t);
+    LzBlockJob<Context, Unit> job(codec, dictSize, pool.size());
+    job.src = src;
+    job.srcLen = srcLen;
+    job.blockSize = blockSize;
+    job.result = &dst;
+    pool.parallelFor(n_block, compressLzBlock<Context, Unit>, &job);
+    return n_block;
+}
+
+/*
+ * 分块并行解压到dst，dstLen须等于各块解压后的长度之和。
+ *
+ * Returns:
+ *     正常情况下返回输出长度，数据损坏时返回-1。
+ */
+template <class Context, class Unit>
+int parallelDecompressLzBlocks(int num_t, const LzBlockResult &src, char *dst, size_t dstLen, int dictSize, LzBlockCodec<Unit> codec) {
+    int n_block = src.rawLens.size();
+    if ((int)src.packed.size() != n_block)
+        return -1;
+    ThreadPool &pool = ThreadPool::shared(num_t);
+    LzBlockJob<Context, Unit> job(codec, dictSize, pool.size());
+    job.offsets.assign(n_block + 1, 0);
+    for (int i = 0; i < n_block; i++) {
+        if (src.rawLens[i] < 0)
+            return -1;
+        job.offsets[i + 1] = job.offsets[i] + src.rawLens[i];
+    }
+    if (dstLen > INT32_MAX || job.offsets[n_block] != (long long)dstLen)
+        return -1;
+    job.input = &src;
+    job.dst = dst;
+    pool.parallelFor(n_block, decompressLzBlock<Context, Unit>, &job);
+    return job.failed ? -1 : dstLen;
+}
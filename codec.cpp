@@ -0,0 +1,77 @@
+#include <climits>
+
+#include "codec.h"
+#include "huffman.h"
+
+using std::vector;
+
+BlockCoder::BlockCoder(int method, int searchBufLen, int lookAheadBufLen, const Lz77Options &options, int dictSize)
+        : method(method), dictSize(dictSize), huffman(options.huffman), lz77(searchBufLen, lookAheadBufLen, options),
+          lz78(dictSize), lzw(dictSize) {}
+
+int BlockCoder::compress(const char *src, int srcLen, vector<char> &out) {
+    size_t before = out.size();
+    if (method == CODEC_LZ77) {
+        units77.clear();
+        lz77.compress(src, srcLen, units77);
+        if (huffman) {
+            huffmanEncodeLz77(units77.data(), units77.size(), out);
+        } else {
+            out.resize(before + Lz77OutputUnit::SIZE * units77.size());
+            char *p = out.data() + before;
+            for (Lz77OutputUnit &u : units77)
+                p += u.write(p);
+        }
+    } else if (method == CODEC_LZ78) {
+        units78.clear();
+        lz78.compress(src, srcLen, units78);
+        packLz78(units78.data(), units78.size(), dictSize, out, lz78.presetSize());
+    } else {
+        unitsW.clear();
+        lzw.compress(src, srcLen, unitsW);
+        packLzW(unitsW.data(), unitsW.size(), dictSize, out, lzw.presetSize());
+    }
+    return out.size() - before;
+}
+
+int BlockCoder::decompress(const char *src, size_t srcLen, vector<char> &out) {
+    size_t before = out.size();
+    if (method == CODEC_LZ77) {
+        units77.clear();
+        if (huffman) {
+            if (srcLen > INT_MAX || huffmanDecodeLz77(src, srcLen, units77) < 0)
+                return -1;
+        } else {
+            if (srcLen % Lz77OutputUnit::SIZE)
+                return -1;
+            units77.resize(srcLen / Lz77OutputUnit::SIZE);
+            for (Lz77OutputUnit &u : units77)
+                src += u.read(src);
+        }
+        if (lz77.decompress(units77.data(), units77.size(), out) < 0)
+            return -1;
+    } else if (method == CODEC_LZ78) {
+        units78.clear();
+        if (unpackLz78(src, srcLen, dictSize, units78, lz78.presetSize()) < 0)
+            return -1;
+        if (lz78.decompress(units78.data(), units78.size(), out) < 0)
+            return -1;
+    } else {
+        unitsW.clear();
+        if (unpackLzW(src, srcLen, dictSize, unitsW, lzw.presetSize()) < 0)
+            return -1;
+        if (lzw.decompress(unitsW.data(), unitsW.size(), out) < 0)
+            return -1;
+    }
+    return out.size() - before;
+}
+
+void BlockCoder::setDictionary(const char *dict, int dictLen) {
+    // 只载入本算法用到的上下文，LZ78/LZW建立快照需要压缩一遍字典
+    if (method == CODEC_LZ77)
+        lz77.setDictionary(dict, dictLen);
+    else if (method == CODEC_LZ78)
+        lz78.setDictionary(dict, dictLen);
+    else
+        lzw.setDictionary(dict, dictLen);
+}
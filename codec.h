@@ -0,0 +1,60 @@
+#pragma once
+#include <vector>
+
+#include "lz77.h"
+#include "lz78.h"
+#include "lzw.h"
+
+/*
+ * 块编码所用的算法
+ */
+enum CodecMethod {
+    CODEC_LZ77,
+    CODEC_LZ78,
+    CODEC_LZW,
+};
+
+/*
+ * 单块编解码器
+ *
+ * 将一块原始数据独立地压缩为字节串，或将这样的字节串还原，块之间不共享字典。
+ * LZ77的三元组按Lz77OutputUnit::SIZE逐个写出，options.huffman为true时改用Huffman编码；LZ78与LZW按位打包。
+ * 内部的上下文与输出单元缓冲在各块之间复用，每个线程持有一个即可。
+ */
+class BlockCoder {
+public:
+    BlockCoder(int method, int searchBufLen, int lookAheadBufLen, const Lz77Options &options, int dictSize);
+
+    /*
+     * 压缩src起始的srcLen个字节，将结果追加到out。
+     *
+     * Returns:
+     *     返回写入的字节数。
+     */
+    int compress(const char *src, int srcLen, std::vector<char> &out);
+
+    /*
+     * 解压由compress写出的srcLen个字节，将结果追加到out。
+     *
+     * Returns:
+     *     正常情况下返回解压出的字节数，数据损坏时返回-1。
+     */
+    int decompress(const char *src, size_t srcLen, std::vector<char> &out);
+
+    /*
+     * 为所用算法的上下文设置预置字典（见dict.h），之后的压缩与解压都先载入它，dictLen为0时取消。
+     * 压缩与解压须使用相同的字典。
+     */
+    void setDictionary(const char *dict, int dictLen);
+
+private:
+    int method;
+    int dictSize;
+    bool huffman;
+    Lz77Context lz77;
+    Lz78Context lz78;
+    LzWContext lzw;
+    std::vector<Lz77OutputUnit> units77;
+    std::vector<Lz78OutputUnit> units78;
+    std::vector<LzWOutputUnit> unitsW;
+};
@@ -0,0 +1,277 @@
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+#include "container.h"
+#include "crc32c.h"
+#include "stats.h"
+#include "threadpool.h"
+
+using std::vector;
+
+static const char HEADER_MAGIC[4] = {'L', 'Z', 'C', 'F'};
+static const char INDEX_MAGIC[4] = {'L', 'Z', 'C', 'X'};
+#define TRAILER_SIZE 12 // 索引末尾的[u32 块数][u32 校验和][魔数]
+
+int ContainerHeader::write(char *buf) const {
+    uint8_t info[4] = {CONTAINER_VERSION, (uint8_t)method, (uint8_t)(huffman ? CONTAINER_FLAG_HUFFMAN : 0), 0};
+    int32_t params[4] = {searchBufLen, lookAheadBufLen, dictSize, blockSize};
+    std::memcpy(buf, HEADER_MAGIC, sizeof(HEADER_MAGIC));
+    std::memcpy(buf + 4, info, sizeof(info));
+    std::memcpy(buf + 8, params, sizeof(params));
+    uint32_t checksum = crc32c(0, buf, BASE_SIZE);
+    std::memcpy(buf + BASE_SIZE, &checksum, sizeof(checksum));
+    return SIZE;
+}
+
+bool ContainerHeader::read(const char *buf, size_t len) {
+    if (!isContainer(buf, len) || len < (size_t)BASE_SIZE)
+        return false;
+    uint8_t info[4];
+    int32_t params[4];
+    std::memcpy(info, buf + 4, sizeof(info));
+    std::memcpy(params, buf + 8, sizeof(params));
+    if (info[0] < 1 || info[0] > CONTAINER_VERSION || info[1] > CODEC_LZW)
+        return false;
+    version = info[0];
+    if (version >= 3) {
+        uint32_t checksum;
+        if (len < (size_t)SIZE)
+            return false;
+        std::memcpy(&checksum, buf + BASE_SIZE, sizeof(checksum));
+        if (checksum != crc32c(0, buf, BASE_SIZE))
+            return false;
+    }
+    method = info[1];
+    huffman = info[2] & CONTAINER_FLAG_HUFFMAN;
+    searchBufLen = params[0];
+    lookAheadBufLen = params[1];
+    dictSize = params[2];
+    blockSize = params[3];
+    return valid();
+}
+
+bool ContainerHeader::valid() const {
+    return searchBufLen >= 0 && searchBufLen <= CONTAINER_MAX_BUF_LEN
+        && lookAheadBufLen >= 0 && lookAheadBufLen <= CONTAINER_MAX_BUF_LEN
+        && dictSize >= (method == CODEC_LZ77 ? 0 : 1) && dictSize <= CONTAINER_MAX_DICT_SIZE
+        && blockSize > 0;
+}
+
+BlockCoder ContainerHeader::coder() const {
+    Lz77Options options;
+    options.huffman = huffman;
+    return BlockCoder(method, searchBufLen, lookAheadBufLen, options, dictSize);
+}
+
+int ContainerBlock::write(char *buf) const {
+    uint32_t v[3] = {rawLen, codedLen | (stored ? CONTAINER_STORED : 0), checksum};
+    std::memcpy(buf, v, sizeof(v));
+    return SIZE;
+}
+
+int ContainerBlock::read(const char *buf) {
+    uint32_t v[3];
+    std::memcpy(v, buf, sizeof(v));
+    rawLen = v[0];
+    codedLen = v[1] & ~CONTAINER_STORED;
+    checksum = v[2];
+    stored = v[1] & CONTAINER_STORED;
+    return SIZE;
+}
+
+bool isContainer(const char *buf, size_t len) {
+    return len >= sizeof(HEADER_MAGIC) && !std::memcmp(buf, HEADER_MAGIC, sizeof(HEADER_MAGIC));
+}
+
+#define PROBE_MIN 4096       // 更短的块直接尝试压缩
+#define PROBE_RUNS 32        // 抽样的段数
+#define PROBE_RUN_LEN 256    // 每段的长度
+#define PROBE_HASH_BITS 12
+
+bool looksIncompressible(const char *src, int srcLen) {
+    if (srcLen < PROBE_MIN)
+        return false;
+    uint32_t hist[256] = {0};
+    uint32_t seen[1 << PROBE_HASH_BITS] = {0}; // 4字节串 -> 该串加1，0表示空
+    int samples = 0, repeats = 0;
+    for (int r = 0; r < PROBE_RUNS; r++) {
+        const char *run = src + (long long)(srcLen - PROBE_RUN_LEN - 3) * r / (PROBE_RUNS - 1);
+        for (int i = 0; i < PROBE_RUN_LEN; i++) {
+            uint32_t v;
+            std::memcpy(&v, run + i, sizeof(v));
+            hist[(unsigned char)run[i]]++;
+            uint32_t &slot = seen[(v * 0x9E3779B1u) >> (32 - PROBE_HASH_BITS)];
+            repeats += slot == v + 1;
+            slot = v + 1;
+            samples++;
+        }
+    }
+    double entropy = 0;
+    for (uint32_t c : hist) {
+        if (c)
+            entropy -= (double)c / samples * std::log2((double)c / samples);
+    }
+    // 8192个均匀随机的样本估计出的熵约为7.97位；随机数据中4字节串重复的概率可以忽略
+    return entropy > 7.9 && repeats < samples / 100;
+}
+
+ContainerBlock encodeContainerFrame(BlockCoder &coder, const char *src, int srcLen, vector<char> &out) {
+    size_t head = out.size();
+    out.resize(head + ContainerBlock::SIZE);
+    ContainerBlock block;
+    block.rawLen = srcLen;
+    block.stored = looksIncompressible(src, srcLen);
+    if (!block.stored) {
+        block.codedLen = coder.compress(src, srcLen, out);
+        block.stored = block.codedLen >= (uint32_t)srcLen;
+    }
+    if (block.stored) {
+        out.resize(head + ContainerBlock::SIZE);
+        out.insert(out.end(), src, src + srcLen);
+        block.codedLen = srcLen;
+        STAT_ADD(stored_blocks, 1);
+    }
+    block.checksum = crc32c(0, src, srcLen);
+    block.write(out.data() + head);
+    return block;
+}
+
+void writeContainerIndex(const vector<ContainerBlock> &blocks, vector<char> &out) {
+    ContainerBlock end;
+    end.rawLen = CONTAINER_END;
+    end.codedLen = blocks.size();
+    size_t head = out.size();
+    out.resize(head + ContainerBlock::SIZE * (blocks.size() + 1) + TRAILER_SIZE);
+    char *p = out.data() + head;
+    p += end.write(p);
+    const char *entries = p;
+    for (const ContainerBlock &block : blocks)
+        p += block.write(p);
+    uint32_t trailer[2] = {(uint32_t)blocks.size(), crc32c(0, entries, p - entries)};
+    std::memcpy(p, trailer, sizeof(trailer));
+    std::memcpy(p + sizeof(trailer), INDEX_MAGIC, sizeof(INDEX_MAGIC));
+}
+
+bool decodeContainerFrame(BlockCoder &coder, const ContainerBlock &block, const char *data, vector<char> &out) {
+    size_t before = out.size();
+    int n;
+    if (block.stored) {
+        if (block.codedLen != block.rawLen)
+            return false;
+        out.insert(out.end(), data, data + block.codedLen);
+        n = block.codedLen;
+    } else {
+        n = coder.decompress(data, block.codedLen, out);
+    }
+    return n >= 0 && (uint32_t)n == block.rawLen && crc32c(0, out.data() + before, n) == block.checksum;
+}
+
+bool ContainerReader::open(const char *buf, size_t len) {
+    this->buf = buf;
+    if (!head.read(buf, len) || len < head.size() + ContainerBlock::SIZE + TRAILER_SIZE)
+        return false;
+    uint32_t trailer[2];
+    std::memcpy(trailer, buf + len - TRAILER_SIZE, sizeof(trailer));
+    if (std::memcmp(buf + len - sizeof(INDEX_MAGIC), INDEX_MAGIC, sizeof(INDEX_MAGIC)))
+        return false;
+    size_t n = trailer[0];
+    if (n > (len - head.size() - ContainerBlock::SIZE - TRAILER_SIZE) / ContainerBlock::SIZE)
+        return false;
+    const char *entries = buf + len - TRAILER_SIZE - ContainerBlock::SIZE * n;
+    if (crc32c(0, entries, ContainerBlock::SIZE * n) != trailer[1])
+        return false;
+
+    // 索引有自己的校验和，各块的位置只由索引算出，不读各帧头：打开文件的代价与块数而非文件长度成正比，
+    // 帧头在解压该块时再与索引核对
+    size_t indexStart = entries - buf - ContainerBlock::SIZE; // 结束标记的位置
+    index.resize(n);
+    dataOffsets.resize(n);
+    rawOffsets.assign(n + 1, 0);
+    size_t pos = head.size();
+    for (size_t i = 0; i < n; i++) {
+        ContainerBlock &block = index[i];
+        block.read(entries + ContainerBlock::SIZE * i);
+        if (block.rawLen > INT_MAX || indexStart - pos < ContainerBlock::SIZE)
+            return false;
+        pos += ContainerBlock::SIZE;
+        if (indexStart - pos < block.codedLen)
+            return false;
+        dataOffsets[i] = pos;
+        pos += block.codedLen;
+        rawOffsets[i + 1] = rawOffsets[i] + block.rawLen;
+    }
+    ContainerBlock end;
+    end.read(buf + indexStart);
+    return pos == indexStart && end.rawLen == CONTAINER_END && end.codedLen == n;
+}
+
+struct ContainerDecompressJob {
+    const ContainerReader *reader;
+    const char *buf;
+    const size_t *dataOffsets;
+    const size_t *rawOffsets;
+    int first;           // 第一个要解压的块
+    size_t begin, end;   // 要输出的原始数据区间
+    char *dst;           // 对应原始数据中的begin
+    vector<BlockCoder> coders; // 每个线程一个
+    vector<vector<char>> outs; // 每个线程的解压缓冲
+    std::atomic<bool> failed;
+};
+
+static void decompressContainerBlock(void *arg, int k, int worker) {
+    ContainerDecompressJob *job = (ContainerDecompressJob *)arg;
+    int i = job->first + k;
+    STAT(uint64_t t0 = lzStatsNow();)
+    const ContainerBlock &block = job->reader->blocks()[i];
+    vector<char> &out = job->outs[worker];
+    out.clear();
+    ContainerBlock frame; // 帧头应与索引一致
+    frame.read(job->buf + job->dataOffsets[i] - ContainerBlock::SIZE);
+    if (frame.rawLen != block.rawLen || frame.codedLen != block.codedLen || frame.checksum != block.checksum
+            || frame.stored != block.stored) {
+        job->failed = true;
+        return;
+    }
+    if (!decodeContainerFrame(job->coders[worker], block, job->buf + job->dataOffsets[i], out)) {
+        job->failed = true;
+        return;
+    }
+    // 只复制块中落在区间内的部分
+    size_t from = std::max(job->begin, job->rawOffsets[i]), to = std::min(job->end, job->rawOffsets[i + 1]);
+    std::memcpy(job->dst + (from - job->begin), out.data() + (from - job->rawOffsets[i]), to - from);
+    STAT(lzStatsBlock(lzStatsNow() - t0, out.size());)
+}
+
+long long ContainerReader::decompress(int num_t, char *dst, size_t dstLen) const {
+    if (dstLen != rawSize())
+        return -1;
+    return decompressRange(num_t, 0, dstLen, dst);
+}
+
+long long ContainerReader::decompressRange(int num_t, size_t begin, size_t len, char *dst) const {
+    size_t end = begin + std::min(len, rawSize() - std::min(begin, rawSize()));
+    if (begin >= end)
+        return 0;
+    // 包含begin的块与包含end - 1的块，长度为0的块不会被选中
+    int first = std::upper_bound(rawOffsets.begin(), rawOffsets.end(), begin) - rawOffsets.begin() - 1;
+    int last = std::upper_bound(rawOffsets.begin(), rawOffsets.end(), end - 1) - rawOffsets.begin() - 1;
+
+    ThreadPool &pool = ThreadPool::shared(num_t);
+    ContainerDecompressJob job;
+    job.reader = this;
+    job.buf = buf;
+    job.dataOffsets = dataOffsets.data();
+    job.rawOffsets = rawOffsets.data();
+    job.first = first;
+    job.begin = begin;
+    job.end = end;
+    job.dst = dst;
+    job.coders.assign(pool.size(), head.coder());
+    job.outs.resize(pool.size());
+    job.failed = false;
+    pool.parallelFor(last - first + 1, decompressContainerBlock, &job);
+    return job.failed ? -1 : (long long)(end - begin);
+}
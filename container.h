@@ -0,0 +1,167 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "codec.h"
+
+/*
+ * 自描述的容器格式
+ *
+ * 文件由头部、若干帧、结束标记与索引组成，全部整数按小端序存储：
+ *     头部   : "LZCF" [u8 版本][u8 算法][u8 标志][u8 保留][i32 searchBufLen][i32 lookAheadBufLen][i32 dictSize][i32 blockSize]
+ *              [u32 头部之前各项的CRC32C]，版本1、2没有校验和
+ *     帧     : [u32 原始长度][u32 编码后长度][u32 原始数据的CRC32C][编码后的数据]，数据由BlockCoder编码，各块互相独立。
+ *              编码后长度的最高位（CONTAINER_STORED）为1时，该块未经压缩，数据就是原始数据
+ *     结束标记 : 原始长度为CONTAINER_END的帧头，编码后长度一项为块数
+ *     索引   : [各块的帧头][u32 块数][u32 索引的CRC32C]"LZCX"
+ * 解压所需的参数都记录在头部，解压时不需要再给出。帧头与结束标记使数据可以顺序读取（流水线解压），
+ * 文件末尾的索引则使解压器可以一次得到全部块的位置与长度，预先分配输出并并行解压。
+ */
+
+#define CONTAINER_VERSION 3          // 版本2加入了存储块，版本3加入了头部的校验和，仍可读取版本1、2
+#define CONTAINER_END UINT32_MAX     // 结束标记中的原始长度
+#define CONTAINER_FLAG_HUFFMAN 1     // LZ77三元组经过Huffman编码
+#define CONTAINER_STORED 0x80000000u // 帧头编码后长度中的存储块标记
+#define CONTAINER_MAX_BUF_LEN INT16_MAX  // searchBufLen与lookAheadBufLen的上限，三元组的偏移量与长度是short
+#define CONTAINER_MAX_DICT_SIZE (1 << 24) // dictSize的上限，解压时按dictSize预先分配短语表
+
+/*
+ * 容器头部
+ */
+struct ContainerHeader {
+    int method = CODEC_LZ77; // 取值见CodecMethod
+    bool huffman = false;
+    int searchBufLen = 0;
+    int lookAheadBufLen = 0;
+    int dictSize = 0;
+    int blockSize = 0;
+
+    int version = CONTAINER_VERSION;
+
+    static const int SIZE = 28;      // 写入缓冲区后占用的字节数
+    static const int BASE_SIZE = 24; // 校验和之前的部分，也是版本1、2的头部长度
+
+    int write(char *buf) const;
+
+    /*
+     * 从buf读入头部，len至少为BASE_SIZE，版本3起至少为SIZE。
+     *
+     * Returns:
+     *     不是容器、版本不支持、校验和不符或参数超出valid()的范围时返回false。
+     */
+    bool read(const char *buf, size_t len);
+
+    /*
+     * 参数是否在容器格式允许的范围内：searchBufLen与lookAheadBufLen不超过CONTAINER_MAX_BUF_LEN，
+     * dictSize不超过CONTAINER_MAX_DICT_SIZE（LZ78/LZW至少为1），blockSize为正。
+     */
+    bool valid() const;
+
+    /*
+     * 头部在文件中的长度，由版本决定。
+     */
+    int size() const { return version >= 3 ? SIZE : BASE_SIZE; }
+
+    /*
+     * 返回按头部参数构造的编解码器。
+     */
+    BlockCoder coder() const;
+};
+
+/*
+ * 帧头，也是索引中的一项
+ */
+struct ContainerBlock {
+    uint32_t rawLen = 0;
+    uint32_t codedLen = 0;  // 数据的字节数，不含CONTAINER_STORED标记
+    uint32_t checksum = 0;
+    bool stored = false;    // 数据是原样存储的原始数据
+
+    static const int SIZE = 12; // 写入缓冲区后占用的字节数
+
+    int write(char *buf) const;
+    int read(const char *buf);
+};
+
+/*
+ * 判断buf是否以容器头部的魔数开始。
+ */
+bool isContainer(const char *buf, size_t len);
+
+/*
+ * 快速估计一块数据是否无法压缩：在均匀分布的若干小段中统计字节的0阶熵与4字节串的重复。
+ * 熵接近8位且几乎没有重复的数据（已压缩的媒体、加密数据等）直接存储，不再尝试压缩。
+ * 只看抽样，块内相距很远的重复可能被漏掉，此时该块也按存储处理。
+ */
+bool looksIncompressible(const char *src, int srcLen);
+
+/*
+ * 用coder压缩src起始的srcLen个字节，将完整的一帧（帧头与数据）追加到out。
+ * looksIncompressible判定无法压缩，或压缩后不比原始数据短时，改为存储块，每块至多比原始数据多一个帧头。
+ *
+ * Returns:
+ *     返回该帧的帧头。
+ */
+ContainerBlock encodeContainerFrame(BlockCoder &coder, const char *src, int srcLen, std::vector<char> &out);
+
+/*
+ * 将结束标记与索引追加到out。blocks为各帧的帧头，按帧的顺序。
+ */
+void writeContainerIndex(const std::vector<ContainerBlock> &blocks, std::vector<char> &out);
+
+/*
+ * 解码容器中的一帧，将原始数据追加到out，并检查长度与校验和。
+ *
+ * Returns:
+ *     数据损坏时返回false。
+ */
+bool decodeContainerFrame(BlockCoder &coder, const ContainerBlock &block, const char *data, std::vector<char> &out);
+
+/*
+ * 容器读取器
+ *
+ * 读入内存中（通常是映射的文件）的整个容器，根据末尾的索引得到各块的位置，并可以并行解压。
+ */
+class ContainerReader {
+public:
+    /*
+     * 解析buf中的容器，检查头部与索引的校验和，各块的位置由索引算出。不读各帧头，
+     * 帧头与索引是否一致、数据的校验和在解压该块时才检查，只解压一段时不会访问其他块。
+     *
+     * Returns:
+     *     格式不正确时返回false。
+     */
+    bool open(const char *buf, size_t len);
+
+    const ContainerHeader &header() const { return head; }
+    const std::vector<ContainerBlock> &blocks() const { return index; }
+
+    /*
+     * 返回解压后的总长度。
+     */
+    size_t rawSize() const { return rawOffsets.back(); }
+
+    /*
+     * 用num_t个线程并行解压全部块到dst，dstLen须等于rawSize()。每块解压后检查校验和。
+     *
+     * Returns:
+     *     正常情况下返回输出长度，数据损坏时返回-1。
+     */
+    long long decompress(int num_t, char *dst, size_t dstLen) const;
+
+    /*
+     * 只解压原始数据中[begin, begin + len)这一段到dst，超出rawSize()的部分被截去。
+     * 借助索引二分查找，只解压与这一段重叠的块，耗时与len而非文件长度成正比。
+     *
+     * Returns:
+     *     正常情况下返回写入dst的长度，数据损坏时返回-1。
+     */
+    long long decompressRange(int num_t, size_t begin, size_t len, char *dst) const;
+
+private:
+    const char *buf;
+    ContainerHeader head;
+    std::vector<ContainerBlock> index;
+    std::vector<size_t> dataOffsets; // 各块编码后的数据在buf中的位置
+    std::vector<size_t> rawOffsets;  // 各块在解压结果中的位置，最后一项为总长度
+};
@@ -0,0 +1,55 @@
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#endif
+
+#include "crc32c.h"
+
+#define CRC32C_POLY 0x82F63B78 // 反转后的Castagnoli多项式
+
+struct Crc32cTable {
+    uint32_t t[256];
+
+    Crc32cTable() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = c & 1 ? (c >> 1) ^ CRC32C_POLY : c >> 1;
+            t[i] = c;
+        }
+    }
+};
+
+static uint32_t crc32cTable(uint32_t crc, const unsigned char *p, size_t len) {
+    static const Crc32cTable table;
+    for (size_t i = 0; i < len; i++)
+        crc = table.t[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t crc32cHardware(uint32_t crc, const unsigned char *p, size_t len) {
+    uint64_t c = crc;
+    for (; len >= 8; p += 8, len -= 8) {
+        uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        c = _mm_crc32_u64(c, v);
+    }
+    crc = c;
+    for (; len > 0; p++, len--)
+        crc = _mm_crc32_u8(crc, *p);
+    return crc;
+}
+#endif
+
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len) {
+    const unsigned char *p = (const unsigned char *)buf;
+    crc = ~crc;
+#if defined(__x86_64__)
+    static const bool hardware = __builtin_cpu_supports("sse4.2");
+    if (hardware)
+        return ~crc32cHardware(crc, p, len);
+#endif
+    return ~crc32cTable(crc, p, len);
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * 计算CRC32C（Castagnoli多项式，iSCSI、ext4等使用的校验和）。
+ * CPU支持SSE4.2时使用crc32指令，每次处理8字节；否则查表，每次处理1字节。
+ *
+ * Params:
+ *     crc : 之前各段数据的校验和，第一段传0。分段计算的结果与对整体计算相同。
+ *
+ * Returns:
+ *     返回包括buf在内的校验和。
+ */
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len);
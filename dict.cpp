@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "dict.h"
+
+using std::vector;
+
+#define DICT_HASH_BITS 20 // d-mer计数表有2^DICT_HASH_BITS项
+
+static inline uint32_t dmerHash(const char *p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return (v * 0x9E3779B97F4A7C15ull) >> (64 - DICT_HASH_BITS);
+}
+
+int trainDictionary(const vector<vector<char>> &samples, int capacity, vector<char> &dict, int segmentLen) {
+    dict.clear();
+    segmentLen = std::max(segmentLen, DICT_DMER_LEN);
+    if (capacity <= 0)
+        return 0;
+
+    // 样本首尾相接，只统计不跨越样本边界的d-mer，hashes[p]为位置p处d-mer的哈希值，-1表示跨越边界
+    vector<char> all;
+    vector<int32_t> hashes;
+    vector<uint32_t> freq(1 << DICT_HASH_BITS, 0); // d-mer出现在多少个样本中
+    vector<int32_t> lastSample(1 << DICT_HASH_BITS, -1);
+    for (size_t i = 0; i < samples.size(); i++) {
+        const vector<char> &s = samples[i];
+        all.insert(all.end(), s.begin(), s.end());
+        for (size_t p = 0; p < s.size(); p++) {
+            if (p + DICT_DMER_LEN > s.size()) {
+                hashes.push_back(-1);
+                continue;
+            }
+            uint32_t h = dmerHash(s.data() + p);
+            hashes.push_back(h);
+            if (lastSample[h] != (int32_t)i) { // 每个样本只计一次
+                lastSample[h] = i;
+                freq[h]++;
+            }
+        }
+    }
+    if (all.size() < (size_t)segmentLen)
+        return 0;
+
+    // 片段的得分为其中各d-mer的样本数之和，只出现在一个样本中的d-mer不计分
+    auto score = [&](size_t p) -> uint64_t {
+        return hashes[p] >= 0 && freq[hashes[p]] > 1 ? freq[hashes[p]] : 0;
+    };
+    int nEpochs = std::max<long long>(1, std::min<long long>(capacity / segmentLen, all.size() / segmentLen));
+    size_t epochLen = all.size() / nEpochs;
+    vector<size_t> chosen; // 按选出的顺序记录片段起点
+    long long filled = 0;
+    bool progress = true;
+    while (filled < capacity && progress) {
+        progress = false;
+        for (int e = 0; e < nEpochs && filled < capacity; e++) {
+            // 在本段中滑动长为segmentLen的窗口，找得分最高的片段
+            size_t begin = e * epochLen, end = std::min(all.size(), begin + epochLen + segmentLen - 1);
+            if (end - begin < (size_t)segmentLen)
+                continue;
+            int window = segmentLen - DICT_DMER_LEN + 1; // 片段中d-mer的个数
+            uint64_t sum = 0, best = 0;
+            size_t bestPos = begin;
+            for (size_t p = begin; p < begin + window; p++)
+                sum += score(p);
+            best = sum;
+            for (size_t p = begin + 1; p + segmentLen <= end; p++) {
+                sum += score(p + window - 1);
+                sum -= score(p - 1);
+                if (sum > best) {
+                    best = sum;
+                    bestPos = p;
+                }
+            }
+            if (best == 0)
+                continue;
+            for (size_t p = bestPos; p < bestPos + window; p++) {
+                if (hashes[p] >= 0)
+                    freq[hashes[p]] = 0;
+            }
+            chosen.push_back(bestPos);
+            filled += segmentLen;
+            progress = true;
+        }
+    }
+
+    // 先选出的片段放在末尾。最后选出的片段放在最前，超出capacity时只取它末尾的一部分
+    long long excess = std::max(0LL, filled - capacity);
+    for (size_t i = chosen.size(); i-- > 0; ) {
+        size_t from = chosen[i] + (i + 1 == chosen.size() ? excess : 0);
+        dict.insert(dict.end(), all.begin() + from, all.begin() + chosen[i] + segmentLen);
+    }
+    return dict.size();
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <vector>
+
+/*
+ * 预置字典训练
+ *
+ * 几百字节到几KB的短数据单独压缩时，LZ77的search buffer是空的，LZ78/LZW的字典也几乎是空的，几乎无法压缩。
+ * 预置字典是一段从样本中挑选出的常见内容，压缩与解压前都先载入它（各上下文的setDictionary），
+ * 短数据从第一个符号起就可以引用其中的字段名、固定格式等。
+ *
+ * 训练方法与zstd的COVER类似：统计每个DICT_DMER_LEN符号的子串（d-mer）出现在多少个样本中，
+ * 把全部样本均分为若干段，每段选出一个长为segmentLen、所含d-mer出现次数之和最大的片段加入字典，
+ * 选中片段中的d-mer计数清零，避免重复的内容再次入选，如此循环直到字典填满。
+ * 先选出的片段价值最高，放在字典末尾：LZ77只能引用末尾的searchBufLen个符号，且偏移量越小越好。
+ */
+
+#define DICT_DMER_LEN 8 // 统计频数的子串长度
+
+/*
+ * 由样本训练字典。
+ *
+ * Params:
+ *     samples : 样本，每个元素是一条完整的数据（如一条消息）。
+ *     capacity : 字典的最大长度。
+ *     dict : 输出的字典，原有内容被替换。
+ *     segmentLen : 每次选出的片段长度，不小于DICT_DMER_LEN。
+ *
+ * Returns:
+ *     返回字典长度。没有在两个以上样本中出现的内容时字典可能比capacity短，甚至为空。
+ */
+int trainDictionary(const std::vector<std::vector<char>> &samples, int capacity, std::vector<char> &dict, int segmentLen = 64);
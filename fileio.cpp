@@ -0,0 +1,134 @@
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "fileio.h"
+
+#define WRITE_BUFFER_SIZE (1 << 20) // 顺序写入时攒够多少字节后写出
+
+MappedFile::~MappedFile() {
+    if (mapped)
+        munmap((void *)ptr, len);
+}
+
+bool MappedFile::open(const char *path) {
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            madvise(p, st.st_size, MADV_SEQUENTIAL);
+            ptr = (const char *)p;
+            len = st.st_size;
+            mapped = true;
+            ::close(fd);
+            return true;
+        }
+    }
+
+    // 无法映射时读入内存
+    char chunk[1 << 16];
+    ssize_t n;
+    while ((n = read(fd, chunk, sizeof(chunk))) > 0)
+        fallback.insert(fallback.end(), chunk, chunk + n);
+    ::close(fd);
+    ptr = fallback.data();
+    len = fallback.size();
+    return n == 0;
+}
+
+InputFile::~InputFile() {
+    if (fd >= 0)
+        ::close(fd);
+}
+
+bool InputFile::open(const char *path) {
+    fd = ::open(path, O_RDONLY);
+    return fd >= 0;
+}
+
+long long InputFile::read(void *buf, size_t n) {
+    size_t total = 0;
+    while (total < n) {
+        ssize_t got = ::read(fd, (char *)buf + total, n - total);
+        if (got < 0)
+            return -1;
+        if (got == 0)
+            break;
+        total += got;
+    }
+    return total;
+}
+
+OutputFile::~OutputFile() {
+    close();
+}
+
+bool OutputFile::open(const char *path) {
+    fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    return fd >= 0;
+}
+
+bool OutputFile::flush() {
+    const char *p = buffer.data();
+    while (buffered > 0) {
+        ssize_t n = ::write(fd, p, buffered);
+        if (n < 0)
+            return false;
+        p += n;
+        buffered -= n;
+    }
+    return true;
+}
+
+bool OutputFile::write(const void *buf, size_t n) {
+    if (buffer.empty())
+        buffer.resize(WRITE_BUFFER_SIZE);
+    if (buffered + n > buffer.size()) {
+        if (!flush())
+            return false;
+        if (n >= buffer.size()) { // 大块数据不经缓冲直接写出
+            const char *p = (const char *)buf;
+            while (n > 0) {
+                ssize_t written = ::write(fd, p, n);
+                if (written < 0)
+                    return false;
+                p += written;
+                n -= written;
+            }
+            return true;
+        }
+    }
+    std::memcpy(buffer.data() + buffered, buf, n);
+    buffered += n;
+    return true;
+}
+
+char *OutputFile::map(size_t n) {
+    if (n == 0 || ftruncate(fd, n) != 0)
+        return NULL;
+    void *p = mmap(NULL, n, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+        return NULL;
+    mapped = (char *)p;
+    mappedLen = n;
+    return mapped;
+}
+
+bool OutputFile::close() {
+    if (fd < 0)
+        return true;
+    bool ok = flush();
+    if (mapped) {
+        munmap(mapped, mappedLen);
+        mapped = NULL;
+    }
+    ok = ::close(fd) == 0 && ok;
+    fd = -1;
+    return ok;
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+/*
+ * 只读的内存映射输入文件。
+ *
+ * 文件内容直接映射到进程地址空间，不复制到堆上。映射失败时（如输入是管道）退而将文件读入内存。
+ */
+class MappedFile {
+public:
+    MappedFile() : ptr(NULL), len(0), mapped(false) {}
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    /*
+     * 打开并映射文件。
+     *
+     * Returns:
+     *     文件无法打开时返回false。
+     */
+    bool open(const char *path);
+
+    const char *data() const { return ptr; }
+    size_t size() const { return len; }
+
+private:
+    const char *ptr;
+    size_t len;
+    bool mapped;
+    std::vector<char> fallback; // 映射失败时存放文件内容
+};
+
+/*
+ * 顺序读取的输入文件。
+ *
+ * 不映射整个文件，每次读入调用者给出的一块，用于读取与计算需要重叠的场合（见pipeline.h）。
+ */
+class InputFile {
+public:
+    InputFile() : fd(-1) {}
+    ~InputFile();
+    InputFile(const InputFile &) = delete;
+    InputFile &operator=(const InputFile &) = delete;
+
+    /*
+     * 打开文件。
+     *
+     * Returns:
+     *     文件无法打开时返回false。
+     */
+    bool open(const char *path);
+
+    /*
+     * 读入n个字节，只有到达文件末尾时才会少于n个。
+     *
+     * Returns:
+     *     返回读入的字节数，读取失败时返回-1。
+     */
+    long long read(void *buf, size_t n);
+
+private:
+    int fd;
+};
+
+/*
+ * 输出文件。
+ *
+ * 可以通过write顺序写入，内部攒够一块后直接调用write系统调用，不经过iostream；
+ * 也可以在已知输出长度时通过map将文件映射到内存，直接在映射区中生成输出。两种方式不能混用。
+ */
+class OutputFile {
+public:
+    OutputFile() : fd(-1), buffered(0), mapped(NULL), mappedLen(0) {}
+    ~OutputFile();
+    OutputFile(const OutputFile &) = delete;
+    OutputFile &operator=(const OutputFile &) = delete;
+
+    /*
+     * 创建或截断文件。
+     *
+     * Returns:
+     *     文件无法创建时返回false。
+     */
+    bool open(const char *path);
+
+    /*
+     * 顺序写入n个字节。
+     *
+     * Returns:
+     *     写入失败时返回false。
+     */
+    bool write(const void *buf, size_t n);
+
+    /*
+     * 将文件长度设为n并映射到内存，调用者直接向返回的映射区写入输出。
+     *
+     * Returns:
+     *     返回映射区起始地址，失败时返回NULL。
+     */
+    char *map(size_t n);
+
+    /*
+     * 写出缓冲区中剩余的数据，解除映射并关闭文件。
+     *
+     * Returns:
+     *     写入失败时返回false。
+     */
+    bool close();
+
+private:
+    bool flush();
+
+    int fd;
+    std::vector<char> buffer;
+    size_t buffered; // buffer中待写出的字节数
+    char *mapped;
+    size_t mappedLen;
+};
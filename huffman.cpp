@@ -0,0 +1,242 @@
+#include <algorithm>
+#include <cstring>
+#include <queue>
+
+#include "huffman.h"
+
+using std::vector;
+
+#define HUFFMAN_BLOCK_UNITS (1 << 16) // 每块的三元组个数
+
+#define LITERAL_SYMBOLS 257 // 未匹配字符0~255，256表示没有未匹配字符
+#define NO_SYMBOL 256
+#define VALUE_SYMBOLS 34    // 长度、偏移量的分组个数，足以表示16位无符号整数
+
+/*
+ * 用Huffman树计算各符号的码长，不限制最大码长。
+ */
+static void huffmanLengths(const vector<uint32_t> &freqs, vector<uint8_t> &lengths) {
+    int n = freqs.size();
+    vector<int> parent(n * 2, -1);
+    std::priority_queue<std::pair<uint64_t, int>, vector<std::pair<uint64_t, int>>, std::greater<std::pair<uint64_t, int>>> heap;
+    for (int i = 0; i < n; i++)
+        if (freqs[i])
+            heap.push({freqs[i], i});
+
+    lengths.assign(n, 0);
+    if (heap.size() == 1) { // 只有一个符号时也要占用1位，否则无法解码
+        lengths[heap.top().second] = 1;
+        return;
+    }
+    int next = n; // 下一个内部节点的编号
+    while (heap.size() > 1) {
+        auto a = heap.top(); heap.pop();
+        auto b = heap.top(); heap.pop();
+        parent[a.second] = parent[b.second] = next;
+        heap.push({a.first + b.first, next++});
+    }
+    // 内部节点的编号大于其子节点，从根向下计算深度
+    vector<int> depth(next, 0);
+    for (int i = next - 2; i >= 0; i--)
+        if (parent[i] >= 0)
+            depth[i] = depth[parent[i]] + 1;
+    for (int i = 0; i < n; i++)
+        if (freqs[i])
+            lengths[i] = std::min(depth[i], 255);
+}
+
+void HuffmanCode::build(const vector<uint32_t> &freqs) {
+    // 码长超过上限时将频数减半后重新构造，直到满足上限
+    vector<uint32_t> f(freqs);
+    while (true) {
+        huffmanLengths(f, lengths);
+        if (*std::max_element(lengths.begin(), lengths.end()) <= HUFFMAN_MAX_CODE_LEN)
+            break;
+        for (uint32_t &x : f)
+            if (x)
+                x = (x + 1) / 2;
+    }
+    assignCodes();
+}
+
+/*
+ * 由码长分配范式码字并建立解码表。
+ */
+bool HuffmanCode::assignCodes() {
+    int n = lengths.size();
+    int count[HUFFMAN_MAX_CODE_LEN + 1] = {0};
+    maxLen = 1;
+    for (int i = 0; i < n; i++) {
+        count[lengths[i]]++;
+        maxLen = std::max(maxLen, (int)lengths[i]);
+    }
+    count[0] = 0;
+
+    // 检查Kraft不等式，并求出每种码长的第一个码字
+    uint32_t nextCode[HUFFMAN_MAX_CODE_LEN + 2];
+    uint32_t code = 0;
+    int left = 1; // 当前码长下还未被占用的码字个数
+    for (int len = 1; len <= HUFFMAN_MAX_CODE_LEN; len++) {
+        left = left * 2 - count[len];
+        if (left < 0)
+            return false;
+        code = (code + count[len - 1]) << 1;
+        nextCode[len] = code;
+    }
+
+    codes.assign(n, 0);
+    table.assign(1 << maxLen, 0);
+    for (int i = 0; i < n; i++) {
+        int len = lengths[i];
+        if (!len)
+            continue;
+        // 位流低位先出，因此将码字按位反转
+        uint32_t c = nextCode[len]++, r = 0;
+        for (int j = 0; j < len; j++)
+            r |= ((c >> j) & 1) << (len - 1 - j);
+        codes[i] = r;
+        for (uint32_t k = r; k < table.size(); k += 1u << len)
+            table[k] = (uint32_t)(i + 1) << 4 | len;
+    }
+    return true;
+}
+
+void HuffmanCode::writeLengths(BitWriter &writer) const {
+    for (uint8_t len : lengths)
+        writer.put(len, 4);
+}
+
+bool HuffmanCode::readLengths(BitReader &reader, int nSymbols) {
+    lengths.resize(nSymbols);
+    for (int i = 0; i < nSymbols; i++)
+        lengths[i] = reader.get(4);
+    return assignCodes();
+}
+
+/*
+ * 将非负整数v分组：小于8的值各自成组，否则按最高位所在位置及次高位分组，其余低位作为附加位直接写出。
+ */
+static inline int valueCode(uint32_t v, int &extraBits) {
+    if (v < 8) {
+        extraBits = 0;
+        return v;
+    }
+    int nb = 32 - __builtin_clz(v); // v的有效位数
+    extraBits = nb - 2;
+    return 8 + (nb - 4) * 2 + ((v >> (nb - 2)) & 1);
+}
+
+static inline void putValue(BitWriter &writer, const HuffmanCode &code, uint32_t v) {
+    int extraBits;
+    code.encode(writer, valueCode(v, extraBits));
+    if (extraBits)
+        writer.put(v & ((1u << extraBits) - 1), extraBits);
+}
+
+static inline int getValue(BitReader &reader, const HuffmanCode &code) {
+    int c = code.decode(reader);
+    if (c < 8)
+        return c; // 包括非法码-1
+    int nb = (c - 8) / 2 + 4;
+    int extraBits = nb - 2;
+    return (1 << (nb - 1)) | ((c & 1) << (nb - 2)) | reader.get(extraBits);
+}
+
+static void encodeBlock(const Lz77OutputUnit *src, int srcLen, vector<char> &out) {
+    // 统计频数并构造码表
+    vector<uint32_t> literalFreqs(LITERAL_SYMBOLS), lengthFreqs(VALUE_SYMBOLS), offsetFreqs(VALUE_SYMBOLS);
+    int extraBits;
+    for (int i = 0; i < srcLen; i++) {
+        lengthFreqs[valueCode(src[i].length, extraBits)]++;
+        if (src[i].length > 0)
+            offsetFreqs[valueCode(std::abs(src[i].offset), extraBits)]++;
+        literalFreqs[src[i].offset >= 0 ? (unsigned char)src[i].symbol : NO_SYMBOL]++;
+    }
+    HuffmanCode literals, lengths, offsets;
+    literals.build(literalFreqs);
+    lengths.build(lengthFreqs);
+    offsets.build(offsetFreqs);
+
+    // 块头：三元组个数，位流字节数
+    size_t head = out.size();
+    uint32_t header[2] = {(uint32_t)srcLen, 0};
+    out.insert(out.end(), (char *)header, (char *)header + sizeof(header));
+
+    BitWriter writer(out);
+    literals.writeLengths(writer);
+    lengths.writeLengths(writer);
+    offsets.writeLengths(writer);
+    for (int i = 0; i < srcLen; i++) {
+        putValue(writer, lengths, src[i].length);
+        if (src[i].length > 0)
+            putValue(writer, offsets, std::abs(src[i].offset));
+        literals.encode(writer, src[i].offset >= 0 ? (unsigned char)src[i].symbol : NO_SYMBOL);
+    }
+    writer.flush();
+
+    header[1] = out.size() - head - sizeof(header);
+    std::memcpy(out.data() + head, header, sizeof(header));
+}
+
+int huffmanEncodeLz77(const Lz77OutputUnit *src, int srcLen, vector<char> &out) {
+    size_t before = out.size();
+    for (int i = 0; i < srcLen; i += HUFFMAN_BLOCK_UNITS)
+        encodeBlock(src + i, std::min(srcLen - i, HUFFMAN_BLOCK_UNITS), out);
+    return out.size() - before;
+}
+
+int huffmanDecodeLz77Block(const char *buf, int bufLen, vector<Lz77OutputUnit> &dst) {
+    uint32_t header[2];
+    if (bufLen < (int)sizeof(header))
+        return -1;
+    std::memcpy(header, buf, sizeof(header));
+    uint32_t nUnits = header[0], nBytes = header[1];
+    if (nBytes > bufLen - sizeof(header) || nUnits > HUFFMAN_BLOCK_UNITS)
+        return -1;
+
+    BitReader reader(buf + sizeof(header), nBytes);
+    HuffmanCode literals, lengths, offsets;
+    if (!literals.readLengths(reader, LITERAL_SYMBOLS) || !lengths.readLengths(reader, VALUE_SYMBOLS)
+            || !offsets.readLengths(reader, VALUE_SYMBOLS))
+        return -1;
+
+    size_t base = dst.size();
+    dst.resize(base + nUnits);
+    Lz77OutputUnit *out = dst.data() + base;
+    for (uint32_t i = 0; i < nUnits; i++) {
+        // 一次补充至少57位，足够读出长度（15 + 14位）与偏移量的码字（15位）
+        reader.refill();
+        int length = getValue(reader, lengths);
+        int offset = 0;
+        if (length > 0) {
+            offset = getValue(reader, offsets);
+            if (offset <= 0)
+                break;
+        }
+        reader.refill();
+        int symbol = literals.decode(reader);
+        if (length < 0 || length > INT16_MAX || offset > INT16_MAX || symbol < 0)
+            break;
+        out[i].length = length;
+        out[i].offset = symbol == NO_SYMBOL ? -offset : offset;
+        out[i].symbol = symbol == NO_SYMBOL ? 0 : symbol;
+        if (i + 1 == nUnits && !reader.overrun())
+            return sizeof(header) + nBytes;
+    }
+    if (nUnits == 0)
+        return sizeof(header) + nBytes;
+
+    dst.resize(base);
+    return -1;
+}
+
+int huffmanDecodeLz77(const char *buf, int bufLen, vector<Lz77OutputUnit> &dst) {
+    size_t before = dst.size();
+    for (int pos = 0; pos < bufLen; ) {
+        int n = huffmanDecodeLz77Block(buf + pos, bufLen - pos, dst);
+        if (n < 0)
+            return -1;
+        pos += n;
+    }
+    return dst.size() - before;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "bitio.h"
+#include "lz77.h"
+
+#define HUFFMAN_MAX_CODE_LEN 15 // 码长上限，解码表大小为2^15
+
+/*
+ * 范式Huffman编码
+ *
+ * 由各符号的频数构造码长不超过HUFFMAN_MAX_CODE_LEN的Huffman码，只需传输各符号的码长即可在解码端重建。
+ * 解码时查一张以接下来maxLen位为下标的表，每个符号只需查表一次。
+ */
+class HuffmanCode {
+public:
+    /*
+     * 由频数构造编码，freqs的长度即符号集大小。
+     */
+    void build(const std::vector<uint32_t> &freqs);
+
+    /*
+     * 写出/读入各符号的码长（每个4位）。读入后即可编码或解码。
+     *
+     * Returns:
+     *     readLengths在码长不构成合法前缀码时返回false。
+     */
+    void writeLengths(BitWriter &writer) const;
+    bool readLengths(BitReader &reader, int nSymbols);
+
+    void encode(BitWriter &writer, int symbol) const { writer.put(codes[symbol], lengths[symbol]); }
+
+    /*
+     * 解码一个符号。调用前缓冲中须有至少HUFFMAN_MAX_CODE_LEN位。
+     *
+     * Returns:
+     *     返回符号，遇到不对应任何符号的码时返回-1。
+     */
+    int decode(BitReader &reader) const {
+        uint32_t entry = table[reader.peek(maxLen)];
+        reader.skip(entry & 0xF);
+        return (int)(entry >> 4) - 1;
+    }
+
+private:
+    bool assignCodes();
+
+    std::vector<uint8_t> lengths; // 各符号的码长，0表示不出现
+    std::vector<uint32_t> codes;  // 各符号的码字，按位流顺序（低位先出）排列
+    std::vector<uint32_t> table;  // 解码表：(符号 + 1) << 4 | 码长，0表示非法码
+    int maxLen;
+};
+
+/*
+ * 将srcLen个三元组用Huffman编码追加到out末尾。
+ * 三元组按HUFFMAN_BLOCK_UNITS个一组分块，每块使用各自的码表，类似Deflate：
+ * 匹配长度与偏移量按数量级分组编码，组内的低位直接写出；未匹配字符与“无字符”标记共用一个符号集。
+ *
+ * Returns:
+ *     返回写入的字节数。
+ */
+int huffmanEncodeLz77(const Lz77OutputUnit *src, int srcLen, std::vector<char> &out);
+
+/*
+ * 从buf中解码一个由huffmanEncodeLz77写出的块，将三元组追加到dst。
+ *
+ * Returns:
+ *     返回该块占用的字节数。数据损坏时返回-1。
+ */
+int huffmanDecodeLz77Block(const char *buf, int bufLen, std::vector<Lz77OutputUnit> &dst);
+
+/*
+ * 解码buf中的全部块，将三元组追加到dst。
+ *
+ * Returns:
+ *     返回解码出的三元组个数。数据损坏时返回-1。
+ */
+int huffmanDecodeLz77(const char *buf, int bufLen, std::vector<Lz77OutputUnit> &dst);
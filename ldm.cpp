@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include "ldm.h"
+#include "matchlen.h"
+#include "stats.h"
+
+using std::vector;
+
+#define LDM_PRIME 0x100000001B3ull // 滚动哈希的乘数
+#define LDM_MIN_HASH_LOG 10
+#define LDM_MAX_HASH_LOG 22        // 指纹表至多4M项，32 MB
+
+/*
+ * 预处理找到的长匹配：[start, start + length)与其之前offset处的数据相同。
+ */
+struct LongMatch {
+    int start;
+    int offset;
+    int length;
+};
+
+/*
+ * 指纹表的一项。check取自指纹中与下标无关的位，核对数据前先排除大部分哈希冲突。
+ */
+struct LdmEntry {
+    int32_t pos; // 窗口的起始位置，-1表示空
+    uint32_t check;
+};
+
+/*
+ * 计算src起始的n个符号的滚动哈希。
+ */
+static inline uint64_t ldmHash(const char *src, int n) {
+    uint64_t h = 0;
+    for (int i = 0; i < n; i++)
+        h = h * LDM_PRIME + (unsigned char)src[i] + 1;
+    return h;
+}
+
+/*
+ * 找出src中的长匹配，按位置顺序追加到matches。
+ * 被接受的长匹配覆盖的数据不再采样，扫描从匹配结束处重新计算滚动哈希。
+ */
+static void findLongMatches(const char *src, int srcLen, int searchBufLen, int lookAheadBufLen, const LdmOptions &ldm, vector<LongMatch> &matches) {
+    int window = std::max(ldm.minMatch, 8);
+    if (srcLen < window)
+        return;
+    int hashLog = ldm.hashLog;
+    if (hashLog <= 0) { // 使表项数不少于历史中的采样数
+        long long samples = (long long)std::min(srcLen, ldm.window) >> ldm.rateLog;
+        for (hashLog = LDM_MIN_HASH_LOG; hashLog < LDM_MAX_HASH_LOG && (1ll << hashLog) < samples; hashLog++);
+    }
+    vector<LdmEntry> table((size_t)1 << hashLog, LdmEntry{-1, 0});
+    uint64_t power = 1; // LDM_PRIME^window，用于移出窗口最左的符号
+    for (int i = 0; i < window; i++)
+        power *= LDM_PRIME;
+    // 指纹的高rateLog位全为0时采样
+    uint64_t sampleMask = ldm.rateLog > 0 ? ~0ull << (64 - std::min(ldm.rateLog, 63)) : 0;
+
+    int anchor = 0;    // 上一个长匹配的结束位置，向前延伸不越过它
+    int skipUntil = 0; // 此前的数据普通LZ77即可找到匹配，只记录指纹，不再核对
+    STAT(uint64_t fingerprints = 0;)
+    int pos = 0;
+    uint64_t h = ldmHash(src, window);
+    while (true) {
+        if ((h & sampleMask) == 0) {
+            uint64_t key = h * 0x9E3779B97F4A7C15ull;
+            LdmEntry &e = table[key >> (64 - hashLog)];
+            uint32_t check = (uint32_t)key;
+            STAT(fingerprints++;)
+            if (pos >= skipUntil && e.pos >= 0 && e.check == check && pos - e.pos <= ldm.window) {
+                int cand = e.pos;
+                int len = matchLength(src + cand, src + pos, srcLen - pos);
+                if (len >= window) {
+                    int back = 0; // 向前延伸
+                    while (pos - back > anchor && cand - back > 0 && src[pos - back - 1] == src[cand - back - 1])
+                        back++;
+                    int offset = pos - cand;
+                    len += back;
+                    if (offset > searchBufLen || len > lookAheadBufLen) {
+                        matches.push_back(LongMatch{pos - back, offset, len});
+                        e.pos = pos;
+                        anchor = pos - back + len;
+                        if (srcLen - anchor < window)
+                            break;
+                        pos = anchor;
+                        h = ldmHash(src + pos, window);
+                        continue;
+                    }
+                    skipUntil = pos - back + len;
+                }
+            }
+            e = LdmEntry{pos, check};
+        }
+        if (pos + window >= srcLen)
+            break;
+        h = h * LDM_PRIME + (unsigned char)src[pos + window] + 1 - ((unsigned char)src[pos] + 1) * power;
+        pos++;
+    }
+    STAT_ADD(ldm_fingerprints, fingerprints);
+}
+
+int compressLz77Long(const char *src, int srcLen, Lz77LongResult &dst, int searchBufLen, int lookAheadBufLen,
+                     const Lz77Options &options, const LdmOptions &ldm) {
+    vector<LongMatch> matches;
+    findLongMatches(src, srcLen, searchBufLen, lookAheadBufLen, ldm, matches);
+
+    // 各间隙以其之前的searchBufLen个符号为字典压缩，与整体压缩时一样可以引用间隙之前的数据
+    Lz77Context context(searchBufLen, lookAheadBufLen, options);
+    dst.matches.clear();
+    dst.units.clear();
+    int pos = 0;
+    STAT(uint64_t matchBytes = 0;)
+    for (const LongMatch &m : matches) {
+        size_t before = dst.units.size();
+        if (m.start > pos)
+            context.compress(src + pos, m.start - pos, dst.units, std::min(pos, searchBufLen));
+        dst.matches.push_back(Lz77LongUnit{(int32_t)(dst.units.size() - before), m.offset, m.length});
+        pos = m.start + m.length;
+        STAT(matchBytes += m.length;)
+    }
+    if (srcLen > pos)
+        context.compress(src + pos, srcLen - pos, dst.units, std::min(pos, searchBufLen));
+    STAT_ADD(ldm_matches, matches.size());
+    STAT_ADD(ldm_match_bytes, matchBytes);
+    return dst.matches.size();
+}
+
+int decompressedSizeLz77Long(const Lz77LongResult &src) {
+    long long size = decompressedSizeLz77(src.units.data(), src.units.size());
+    if (size < 0)
+        return -1;
+    for (const Lz77LongUnit &m : src.matches) {
+        if (m.length < 0)
+            return -1;
+        size += m.length;
+    }
+    return size <= INT32_MAX ? size : -1;
+}
+
+int decompressLz77Long(const Lz77LongResult &src, char *dst, int dstLen) {
+    char *out = dst, *end = dst + dstLen;
+    const Lz77OutputUnit *units = src.units.data();
+    size_t next = 0; // 下一个待解压的三元组
+    for (const Lz77LongUnit &m : src.matches) {
+        if (m.units < 0 || (size_t)m.units > src.units.size() - next)
+            return -1;
+        int n = decompressLz77(units + next, m.units, out, end - out, out - dst);
+        if (n < 0)
+            return -1;
+        out += n;
+        next += m.units;
+        if (m.offset <= 0 || m.offset > out - dst || m.length < 0 || m.length > end - out)
+            return -1;
+        // 与三元组的重叠匹配相同，[from, out)中已是完整的模式，每次整体复制到末尾
+        const char *from = out - m.offset;
+        for (int length = m.length; length > 0; ) {
+            int k = std::min<long long>(length, out - from);
+            std::memcpy(out, from, k);
+            out += k;
+            length -= k;
+        }
+    }
+    int n = decompressLz77(units + next, src.units.size() - next, out, end - out, out - dst);
+    if (n < 0)
+        return -1;
+    return out + n - dst;
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "lz77.h"
+
+/*
+ * 长距离匹配（long distance matching）
+ *
+ * 三元组的偏移量与长度都是short，LZ77只能找到32767个符号以内的重复。长距离匹配在此之前对整个输入做一遍预处理：
+ * 以minMatch个符号为窗口计算滚动哈希（指纹），按指纹的高位采样约1/2^rateLog的位置记入指纹表，
+ * 之后遇到指纹相同的采样位置时核对数据并向前后延伸，得到偏移量与长度都可达2^31的长匹配。
+ * 采样只取决于窗口内的数据，重复出现的内容在两处的采样位置相同，因此相距多远都能找到。
+ * 长匹配之间的间隙仍由普通的LZ77压缩为三元组，间隙可以引用其之前searchBufLen个符号（包括长匹配复制出的数据）。
+ * 被长匹配覆盖的数据不再逐个位置查找匹配，重复内容多的输入压缩得更快。
+ */
+
+/*
+ * 长匹配单元：先解压units个三元组，再从当前位置之前offset处复制length个符号。
+ * 最后一个长匹配之后的三元组不属于任何单元，解压时在最后处理。
+ */
+struct Lz77LongUnit {
+    int32_t units;  // 此前的间隙由多少个三元组编码
+    int32_t offset; // 长匹配的偏移量
+    int32_t length; // 长匹配的长度
+
+    static const int SIZE = sizeof(int32_t) * 3; // 写入缓冲区后占用的字节数
+
+    int write(char *buf) const {
+        std::memcpy(buf, &units, sizeof(units));
+        std::memcpy(buf + 4, &offset, sizeof(offset));
+        std::memcpy(buf + 8, &length, sizeof(length));
+        return SIZE;
+    }
+    int read(const char *buf) {
+        std::memcpy(&units, buf, sizeof(units));
+        std::memcpy(&offset, buf + 4, sizeof(offset));
+        std::memcpy(&length, buf + 8, sizeof(length));
+        return SIZE;
+    }
+};
+
+/*
+ * 长距离匹配选项
+ */
+struct LdmOptions {
+    int window = 128 << 20; // 长匹配的偏移量至多为window
+    int minMatch = 64;      // 指纹窗口的长度，也是最短的长匹配
+    int rateLog = 5;        // 约每2^rateLog个位置采样一个指纹
+    int hashLog = 0;        // 指纹表有2^hashLog项，0表示按输入长度选择
+};
+
+/*
+ * 长距离匹配的压缩结果
+ */
+struct Lz77LongResult {
+    std::vector<Lz77LongUnit> matches; // 长匹配
+    std::vector<Lz77OutputUnit> units; // 各间隙的三元组，按顺序连接
+};
+
+/*
+ * 使用长距离匹配与LZ77压缩src起始的srcLen个符号。
+ * 普通LZ77可以用一个三元组表示的匹配（偏移量不超过searchBufLen且长度不超过lookAheadBufLen）仍交给三元组，
+ * 只有超出这一范围的才作为长匹配输出。
+ *
+ * Params:
+ *     searchBufLen, lookAheadBufLen, options : 压缩间隙所用的LZ77参数，与compressLz77相同。
+ *     ldm : 长距离匹配选项，详见LdmOptions。
+ *
+ * Returns:
+ *     返回长匹配个数。
+ */
+int compressLz77Long(const char *src, int srcLen, Lz77LongResult &dst, int searchBufLen, int lookAheadBufLen,
+                     const Lz77Options &options = Lz77Options(), const LdmOptions &ldm = LdmOptions());
+
+/*
+ * 计算解压后的长度，可用于预先分配输出缓冲区。
+ *
+ * Returns:
+ *     返回解压后的长度，数据损坏或超过int表示范围时返回-1。
+ */
+int decompressedSizeLz77Long(const Lz77LongResult &src);
+
+/*
+ * 解压compressLz77Long的结果，直接写入调用者提供的缓冲区。
+ *
+ * Returns:
+ *     正常情况下返回输出长度。输出超过dstLen、偏移量超出已解压的数据或单元数不符时返回-1。
+ */
+int decompressLz77Long(const Lz77LongResult &src, char *dst, int dstLen);
@@ -1,210 +1,504 @@
 #include <cstdint>
 #include <cstring>
 #include <algorithm>
+#include <atomic>
 #include <pthread.h>
 #include <cmath>
 #include "lz77.h"
+#include "huffman.h"
+#include "matchfinder.h"
+#include "matchlen.h"
+#include "stats.h"
+#include "threadpool.h"
 
 using std::vector;
 
 /*
- * 尝试匹配符号串a与b，至多匹配maxLen个符号。
- *
- * Returns:
- *     返回成功匹配的长度。
+ * 流式压缩时look ahead buffer之后须已有的数据长度。惰性匹配要在look ahead buffer以内的位置再向后查找，
+ * 需要两倍的长度，才能保证每次查找的maxLen与整块压缩时相同。
  */
-int match(const vector<char> &src, int a, int b, int maxLen) {
-    for (int i = 0; i < maxLen; i++) {
-        if (src[a + i] != src[b + i])
-            return i;
-    }
-    return maxLen;
+static int lookAheadHorizon(int lookAheadBufLen, const Lz77Options &options) {
+    return options.lazy > 0 ? lookAheadBufLen * 2 : lookAheadBufLen;
 }
 
-int _compressLz77(const vector<char> &src, int srcOffset, int srcLen, vector<Lz77OutputUnit> &dst, int searchBufLen, int lookAheadBufLen, int t_id=0) {
-    int pos = 0; // look ahead buffer最左符号在src中的下标，表示buffer的位置，随着循环更新。
-    while (pos < srcLen) {
+/*
+ * 从pos开始编码buf中的数据。final为false时，只编码到[pos, end)中的数据不足lookAheadHorizon为止；
+ * final为true时，编码到end为止。整块压缩与流式压缩共用这一循环，因此二者输出相同。
+ *
+ * options.lazy大于0时使用惰性匹配。三元组自带一个未匹配字符，贪心地取最长匹配后，下一个三元组也能从原来的偏移量
+ * 继续匹配，因此经典的“下一位置更长则先输出字面量”在这里并不省三元组。这里推迟的是匹配的终点：
+ * 把最长匹配截短0..lazy个符号，选下一个三元组能到达最远的方案（相同时取较长者，即贪心的结果），
+ * 截短到0即输出字面量。查找器总能找到最长匹配时，这样做不会比贪心更好；它弥补的是哈希链因链长限制漏掉的匹配。
+ * niceLen以上的匹配直接采用。
+ *
+ * Returns:
+ *     返回编码停止时的pos。
+ */
+static int encodeLz77(MatchFinder &finder, const char *buf, int pos, int end, bool final, int lookAheadBufLen, const Lz77Options &options, vector<Lz77OutputUnit> &dst) {
+    int horizon = lookAheadHorizon(lookAheadBufLen, options);
+    int lazy = std::min(std::max(options.lazy, 0), MatchFinder::CACHE_SIZE - 2); // 试探的位置须都留在查找器的缓存中
+    int niceLen = options.niceLen > 0 ? options.niceLen : lookAheadBufLen;
+    STAT(int start = pos; size_t before = dst.size(); uint64_t literals = 0, matchBytes = 0, matchMax = 0;)
+    while (final ? pos < end : pos + horizon <= end) {
         // 找出最长匹配
-        int bestOffset = -1; // 已找到的最长匹配的偏移量
-        int bestMatchLen = 0; // 已找到的最长匹配的长度
-        for (int i = std::min(pos, searchBufLen); i >= 1; i--) { // 从左至右遍历search buffer，以每个字符为首字符尝试匹配。
-                                                  // 此处i相当于offset，因此是从searchBufLen减小到1。
-            int matchLen = match(src, srcOffset + pos - i, srcOffset + pos,
-                    std::min({           // 以下是match函数的第3个参数，用于决定最长匹配多长的符号串。
-                        lookAheadBufLen, // 长度不可超过look ahead buffer
-                        srcLen - pos,    // 长度不可超过输入数据
-                    }));
-            if (matchLen > bestMatchLen) {
-                bestOffset = i;
-                bestMatchLen = matchLen;
+        int maxLen = std::min({ // 最长匹配多长的符号串
+                lookAheadBufLen, // 长度不可超过look ahead buffer
+                end - pos,       // 长度不可超过输入数据
+            });
+        int bestOffset; // 已找到的最长匹配的偏移量
+        int bestMatchLen = finder.find(pos, maxLen, bestOffset); // 已找到的最长匹配的长度
+
+        // 惰性匹配：只在三元组带有未匹配字符时考虑截短
+        if (lazy > 0 && bestMatchLen < niceLen && bestMatchLen < lookAheadBufLen && pos + bestMatchLen < end) {
+            int bestLen = bestMatchLen, bestReach = -1;
+            for (int len = std::max(0, bestMatchLen - lazy); len <= bestMatchLen; len++) {
+                int next = pos + len + 1, nextOffset;
+                int reach = next < end ? next + finder.find(next, std::min(lookAheadBufLen, end - next), nextOffset) : next;
+                if (reach >= bestReach) {
+                    bestReach = reach;
+                    bestLen = len;
+                }
             }
+            bestMatchLen = bestLen;
+            if (bestLen == 0)
+                bestOffset = 0;
         }
-        if (bestMatchLen == 0) // search buffer中没有可匹配的串。
-            bestOffset = 0;
 
         // 编码三元组并移动buffer
         Lz77OutputUnit newUnit;
         newUnit.offset = bestOffset;
         newUnit.length = bestMatchLen;
-        if (bestMatchLen < lookAheadBufLen && pos + bestMatchLen < srcLen) {
+        if (bestMatchLen < lookAheadBufLen && pos + bestMatchLen < end) {
             // 仅当输入未被匹配完，且look ahead buffer中还有未匹配的符号时才填写symbol字段。
-            newUnit.symbol = src[srcOffset + pos + bestMatchLen];
+            newUnit.symbol = buf[pos + bestMatchLen];
             pos += bestMatchLen + 1;
         } else {
             newUnit.offset = -newUnit.offset; // 当symbol为空时，改变offset的符号来表示这种特殊情况，因为offset应总为非负的。
             pos += bestMatchLen;
         }
         dst.push_back(newUnit);
+        STAT(literals += bestMatchLen == 0; matchBytes += bestMatchLen; matchMax = std::max<uint64_t>(matchMax, bestMatchLen);)
     }
+    STAT_ADD(lz77_positions, pos - start);
+    STAT_ADD(lz77_units, dst.size() - before);
+    STAT_ADD(lz77_literals, literals);
+    STAT_ADD(lz77_match_bytes, matchBytes);
+    STAT_MAX(lz77_match_max, matchMax);
+    return pos;
+}
+
+Lz77Options lz77Level(int level) {
+    // {查找方式, 链长, 惰性截短的符号数, niceLen}
+    static const int levels[9][4] = {
+        {LZ77_MF_HASH_CHAIN, 4, 0, 16},
+        {LZ77_MF_HASH_CHAIN, 8, 0, 32},
+        {LZ77_MF_HASH_CHAIN, 16, 0, 32},
+        {LZ77_MF_HASH_CHAIN, 16, 1, 64},
+        {LZ77_MF_HASH_CHAIN, 32, 1, 64},
+        {LZ77_MF_HASH_CHAIN, 64, 1, 128},
+        {LZ77_MF_HASH_CHAIN, 256, 1, 0},
+        {LZ77_MF_HASH_CHAIN, 1024, 2, 0},
+        {LZ77_MF_BINARY_TREE, 0, 0, 0}, // 二叉树总能找到最长匹配，此时惰性匹配不会减少三元组，见encodeLz77
+    };
+    const int *l = levels[std::min(std::max(level, 1), 9) - 1];
+    Lz77Options options;
+    options.matchFinder = l[0];
+    options.chainDepth = l[1] ? l[1] : options.chainDepth;
+    options.lazy = l[2];
+    options.niceLen = l[3];
+    return options;
+}
+
+int compressLz77(const char *src, int srcLen, vector<Lz77OutputUnit> &dst, int searchBufLen, int lookAheadBufLen, const Lz77Options &options) {
+    MatchFinder finder;
+    finder.reset(options.matchFinder, src, 0, srcLen, searchBufLen, lookAheadBufLen, options.chainDepth, options.niceLen);
+    encodeLz77(finder, src, 0, srcLen, true, lookAheadBufLen, options, dst);
 
     return dst.size();
 }
 
-int compressLz77(const vector<char> &src, vector<Lz77OutputUnit> &dst, int searchBufLen, int lookAheadBufLen) {
-    return _compressLz77(src, 0, src.size(), dst, searchBufLen, lookAheadBufLen);
+int compressLz77(const vector<char> &src, vector<Lz77OutputUnit> &dst, int searchBufLen, int lookAheadBufLen, const Lz77Options &options) {
+    return compressLz77(src.data(), src.size(), dst, searchBufLen, lookAheadBufLen, options);
 }
 
-int _decompressLz77(const vector<Lz77OutputUnit> &src, vector<char> &dst, int searchBufLen, int lookAheadBufLen, int t_id=0) {
-    int pos = 0; // look ahead buffer最左符号在dst中的下标，表示buffer的位置，随着循环更新。
-    for (int i = 0; i < src.size(); i++) {
-        if (src[i].offset == 0) { // 没有匹配串，直接输出未匹配字符
-            dst.push_back(src[i].symbol);
-            pos++;
-        } else { // 有匹配串
-            // 先输出匹配串
-            int offset = std::abs(src[i].offset);
-            for (int j = 0; j < src[i].length; j++) {
-                dst.push_back(dst[pos - offset + j]);
-            }
-            pos += src[i].length;
+int decompressedSizeLz77(const Lz77OutputUnit *src, int srcLen) {
+    long long size = 0;
+    for (int i = 0; i < srcLen; i++)
+        size += src[i].length + (src[i].offset >= 0); // offset为负表示symbol为空
+    return size <= INT32_MAX ? size : -1;
+}
 
-            // 然后检查匹配串之后是否有未匹配字符，有则输出
-            if (src[i].offset >= 0) { // offset为负表示symbol为空
-                dst.push_back(src[i].symbol);
-                pos++;
-            }
+/*
+ * 将dst - offset处的length个符号复制到dst。
+ * offset < length时源与目标重叠，匹配串是以offset为周期重复的模式。
+ */
+static inline void copyMatch(char *dst, char *dstEnd, int offset, int length) {
+    const char *from = dst - offset;
+    if (offset >= length) {
+        if (length <= 16 && offset >= 16 && dstEnd - dst >= 16)
+            std::memcpy(dst, from, 16); // 短匹配一次复制16字节，多复制的部分会被之后的输出覆盖
+        else
+            std::memcpy(dst, from, length);
+    } else if (offset == 1) {
+        std::memset(dst, *from, length);
+    } else {
+        // [from, dst)中已是完整的模式，每次将其整体复制到末尾，可复制的长度逐次翻倍
+        while (length > 0) {
+            int n = std::min(length, (int)(dst - from));
+            std::memcpy(dst, from, n);
+            dst += n;
+            length -= n;
         }
     }
+}
 
-    return dst.size();
+/*
+ * 解压一个三元组，写入out。base为已解压数据的起始位置，dstEnd为输出缓冲区的结束位置。
+ *
+ * Returns:
+ *     返回输出的符号个数。输出超过缓冲区或偏移量超出已解压的数据时返回-1。
+ */
+static inline int decompressLz77Unit(const Lz77OutputUnit &unit, const char *base, char *out, char *dstEnd) {
+    int offset = std::abs(unit.offset);
+    int length = unit.length;
+    bool hasSymbol = unit.offset >= 0; // offset为负表示symbol为空
+    if (length < 0 || dstEnd - out < length + hasSymbol)
+        return -1; // 输出超过缓冲区
+    if (length > 0) {
+        if (offset == 0 || offset > out - base)
+            return -1; // 偏移量超出已解压的数据
+        copyMatch(out, dstEnd, offset, length);
+    }
+    if (hasSymbol)
+        out[length] = unit.symbol;
+    return length + hasSymbol;
+}
+
+/*
+ * 将srcLen个三元组解压到[start, dstEnd)，[base, start)是可以引用的已有数据。
+ * 第一次引用start之前的数据时调用waitHistory，调用者借此等待这部分数据就绪。
+ *
+ * Returns:
+ *     返回输出的符号个数，数据损坏时返回-1。
+ */
+template <class Wait>
+static int decompressLz77Block(const Lz77OutputUnit *src, int srcLen, const char *base, char *start, char *dstEnd, Wait waitHistory) {
+    char *out = start; // 下一个输出符号的位置
+    bool ready = base == start; // start之前的数据是否已就绪
+    for (int i = 0; i < srcLen; i++) {
+        if (!ready && src[i].length > 0 && std::abs(src[i].offset) > out - start) {
+            waitHistory();
+            ready = true;
+        }
+        int len = decompressLz77Unit(src[i], base, out, dstEnd);
+        if (len < 0)
+            return -1;
+        out += len;
+    }
+    STAT_ADD(lz77_decoded_units, srcLen);
+    STAT_ADD(lz77_decoded_bytes, out - start);
+
+    return out - start;
 }
 
-int decompressLz77(const vector<Lz77OutputUnit> &src, vector<char> &dst, int searchBufLen, int lookAheadBufLen) {
-    return _decompressLz77(src, dst, searchBufLen, lookAheadBufLen);
+int decompressLz77(const Lz77OutputUnit *src, int srcLen, char *dst, int dstLen, int dictLen) {
+    return decompressLz77Block(src, srcLen, dst - dictLen, dst, dst + dstLen, [] {});
 }
 
 /*
- * 由于Pthread仅支持传递一个参数，因此将所有参数打包为一个结构体，
- * 并将compressLz77和decompressLz77打包成_parallel_compressLz77和_parallel_decompressLz77
+ * 将srcLen个三元组解压后追加到dst。
  */
+static int decompressAppend(const Lz77OutputUnit *src, int srcLen, vector<char> &dst) {
+    // 预先计算输出长度，一次性分配空间后直接写入
+    int outLen = decompressedSizeLz77(src, srcLen);
+    if (outLen < 0)
+        return -1;
+    size_t base = dst.size();
+    dst.resize(base + outLen);
+    if (decompressLz77(src, srcLen, dst.data() + base, outLen) < 0) {
+        dst.resize(base);
+        return -1;
+    }
 
-struct CompressLz77Args {
-    int t_id;
-    const vector<char> *src = NULL;
-    int srcOffset;
-    int srcLen;
-    vector<Lz77OutputUnit> *dst = NULL;
-    int searchBufLen;
-    int lookAheadBufLen;
-};
+    return dst.size();
+}
 
-struct DecompressLz77Args {
-    int t_id;
-    const vector<Lz77OutputUnit> *src;
-    vector<char> *dst;
-    int searchBufLen;
-    int lookAheadBufLen;
-};
+int decompressLz77(const vector<Lz77OutputUnit> &src, vector<char> &dst, int /* searchBufLen */, int /* lookAheadBufLen */) {
+    return decompressAppend(src.data(), src.size(), dst);
+}
+
+Lz77Context::Lz77Context(int searchBufLen, int lookAheadBufLen, const Lz77Options &options)
+        : searchBufLen(searchBufLen), lookAheadBufLen(lookAheadBufLen), options(options), presetLen(0) {}
 
-void *_parallel_compressLz77(void *args) {
-    CompressLz77Args *xargs = (CompressLz77Args*) args;
-    intptr_t len = _compressLz77(*(xargs->src), xargs->srcOffset, xargs->srcLen, *(xargs->dst), xargs->searchBufLen, xargs->lookAheadBufLen, xargs->t_id);
-    return (void*)len;
-}
-
-int parallel_compressLz77(int num_t, const vector<char> &src, Lz77ParallelResult &dst, int searchBufLen, int lookAheadBufLen) {
-    // 分发参数
-    CompressLz77Args args[num_t];
-    int block_len = (src.size() + num_t - 1) / num_t;
-
-    if (dst.lens.size())
-        dst.lens.clear();
-    if (dst.blocks.size())
-        dst.blocks.clear();
-    for (int i = 0; i < num_t; i++)
-        dst.blocks.push_back(vector<Lz77OutputUnit>());
-
-    for (int i = 0; i < num_t; ++i) {
-        args[i].t_id = i;
-        args[i].src = &src;
-        args[i].srcOffset = block_len * i;
-        args[i].srcLen = std::min(src.size() - (block_len * i),
-                (unsigned long long)block_len); // 长度
-        args[i].dst = &dst.blocks[i];
-        args[i].searchBufLen = searchBufLen;
-        args[i].lookAheadBufLen = lookAheadBufLen;
+void Lz77Context::setDictionary(const char *dict, int dictLen) {
+    // 只有最后searchBufLen个符号可能被引用
+    presetLen = std::max(0, std::min(dictLen, searchBufLen));
+    window.assign(dict + dictLen - presetLen, dict + dictLen);
+    if (presetLen > 0 && options.matchFinder == LZ77_MF_HASH_CHAIN) {
+        presetFinder.reset(options.matchFinder, window.data(), 0, presetLen, searchBufLen, lookAheadBufLen, options.chainDepth, options.niceLen);
+        presetFinder.indexAll();
     }
+}
 
-    // 创建子线程
-    pthread_t threads[num_t];
+int Lz77Context::compress(const char *src, int srcLen, vector<Lz77OutputUnit> &dst, int dictLen) {
+    if (presetLen > 0 && dictLen == 0) {
+        // 数据接在预置字典之后。哈希链查找时字典的索引已经建立，只索引新数据；其他查找方式连同字典一起索引
+        window.resize(presetLen);
+        window.insert(window.end(), src, src + srcLen);
+        bool shared = options.matchFinder == LZ77_MF_HASH_CHAIN;
+        finder.reset(options.matchFinder, window.data(), shared ? presetLen : 0, presetLen + srcLen, searchBufLen, lookAheadBufLen, options.chainDepth, options.niceLen);
+        if (shared)
+            finder.attach(presetFinder);
+        encodeLz77(finder, window.data(), presetLen, presetLen + srcLen, true, lookAheadBufLen, options, dst);
+        return dst.size();
+    }
+    // 查找器从字典的起始位置开始建立索引，编码从src开始
+    finder.reset(options.matchFinder, src - dictLen, 0, dictLen + srcLen, searchBufLen, lookAheadBufLen, options.chainDepth, options.niceLen);
+    encodeLz77(finder, src - dictLen, dictLen, dictLen + srcLen, true, lookAheadBufLen, options, dst);
+    return dst.size();
+}
+
+int Lz77Context::decompress(const Lz77OutputUnit *src, int srcLen, vector<char> &dst) {
+    if (presetLen == 0)
+        return decompressAppend(src, srcLen, dst);
+    // 解压到预置字典之后，三元组可以引用字典
+    int outLen = decompressedSizeLz77(src, srcLen);
+    if (outLen < 0)
+        return -1;
+    window.resize(presetLen + outLen);
+    if (decompressLz77(src, srcLen, window.data() + presetLen, outLen, presetLen) < 0)
+        return -1;
+    dst.insert(dst.end(), window.begin() + presetLen, window.end());
+    return dst.size();
+}
 
-    for (int i = 0; i < num_t; ++i) {
-        int res_code = pthread_create(&threads[i], NULL, _parallel_compressLz77, (void*)&args[i]);
-        if (res_code) return -1;
+Lz77StreamEncoder::Lz77StreamEncoder(int searchBufLen, int lookAheadBufLen, const Lz77Options &options)
+        : searchBufLen(searchBufLen), lookAheadBufLen(lookAheadBufLen), options(options) {
+    // 窗口容纳两段windowSize与lookAheadHorizon个符号：编码停在窗口末尾之前lookAheadHorizon处时，
+    // pos之前至少有windowSize + 1 > searchBufLen个符号，整体前移windowSize后search buffer仍然完整
+    windowSize = matchWindowSize(searchBufLen);
+    window.resize(windowSize * 2 + lookAheadHorizon(lookAheadBufLen, options));
+    pos = end = 0;
+    finder.reset(options.matchFinder, window.data(), 0, 0, searchBufLen, lookAheadBufLen, options.chainDepth, options.niceLen);
+}
+
+int Lz77StreamEncoder::encode(bool final, vector<Lz77OutputUnit> &dst) {
+    size_t before = dst.size();
+    finder.extend(end);
+    pos = encodeLz77(finder, window.data(), pos, end, final, lookAheadBufLen, options, dst);
+    return dst.size() - before;
+}
+
+int Lz77StreamEncoder::update(const char *src, int srcLen, vector<Lz77OutputUnit> &dst) {
+    int count = 0;
+    while (srcLen > 0) {
+        if (end == window.size()) { // 窗口已满，整体前移windowSize
+            std::memmove(window.data(), window.data() + windowSize, end - windowSize);
+            pos -= windowSize;
+            end -= windowSize;
+            finder.slide(windowSize);
+        }
+        int n = std::min(srcLen, (int)window.size() - end);
+        std::memcpy(window.data() + end, src, n);
+        src += n;
+        srcLen -= n;
+        end += n;
+        count += encode(false, dst);
     }
+    return count;
+}
 
-    // 回收结果
-    int len = 0;    // 统计每个子线程压缩结果各自长度之和
+int Lz77StreamEncoder::finish(vector<Lz77OutputUnit> &dst) {
+    int count = encode(true, dst);
+    pos = end = 0;
+    finder.reset(options.matchFinder, window.data(), 0, 0, searchBufLen, lookAheadBufLen, options.chainDepth, options.niceLen);
+    return count;
+}
+
+Lz77StreamDecoder::Lz77StreamDecoder(int searchBufLen, int lookAheadBufLen)
+        : searchBufLen(searchBufLen), lookAheadBufLen(lookAheadBufLen) {
+    // 一个三元组至多输出lookAheadBufLen + 1个符号
+    history.resize(searchBufLen * 2 + lookAheadBufLen + 1);
+    end = 0;
+}
 
-    for (int i = 0; i < num_t; ++i) {
-        void *retval;
-        if (pthread_join(threads[i], &retval))
+int Lz77StreamDecoder::update(const Lz77OutputUnit *src, int srcLen, vector<char> &dst) {
+    size_t before = dst.size();
+    int flushed = end; // history中已追加到dst的数据的结束位置
+    for (int i = 0; i < srcLen; i++) {
+        if (src[i].length < 0 || src[i].length > lookAheadBufLen || std::abs(src[i].offset) > searchBufLen)
             return -1;
-        int _len = (intptr_t) retval;
-        len += _len;
-        dst.lens.push_back(_len);   // 每个子线程的返回值为压缩后的三元组个数
+        if (history.size() - end < src[i].length + 1) { // 空间不足，只保留最近searchBufLen个符号
+            dst.insert(dst.end(), history.data() + flushed, history.data() + end);
+            int keep = std::min(end, searchBufLen);
+            std::memmove(history.data(), history.data() + end - keep, keep);
+            end = flushed = keep;
+        }
+        int len = decompressLz77Unit(src[i], history.data(), history.data() + end, history.data() + history.size());
+        if (len < 0)
+            return -1;
+        end += len;
     }
+    dst.insert(dst.end(), history.data() + flushed, history.data() + end);
+    return dst.size() - before;
+}
 
-    return len;
+/*
+ * 线程池只支持传递一个参数，因此将并行压缩、解压的所有参数打包为一个结构体，每个块作为线程池中的一个下标执行。
+ */
+
+struct CompressLz77Job {
+    const char *src;
+    int srcLen;
+    int blockSize;
+    int window;
+    Lz77ParallelResult *dst;
+    vector<Lz77Context> *contexts; // 每个线程一个，复用匹配查找器的索引
+    const Lz77Options *options;
+};
+
+struct DecompressLz77Job {
+    const Lz77ParallelResult *src;
+    vector<vector<Lz77OutputUnit>> units; // Huffman编码时各线程解码出的三元组
+    vector<long long> offsets;            // 各块在输出中的起始位置，最后一项为总长度
+    char *dst;
+    vector<char> done;                    // 各块是否已解压完毕
+    pthread_mutex_t lock;
+    pthread_cond_t doneCond;
+    std::atomic<bool> failed;
+};
+
+static void compressLz77Block(void *arg, int i, int worker) {
+    CompressLz77Job *job = (CompressLz77Job*) arg;
+    STAT(uint64_t t0 = lzStatsNow();)
+    int offset = (int)std::min((long long)job->blockSize * i, (long long)job->srcLen);
+    int len = std::min(job->srcLen - offset, job->blockSize);
+    vector<Lz77OutputUnit> &units = job->dst->blocks[i];
+    (*job->contexts)[worker].compress(job->src + offset, len, units, std::min(offset, job->window));
+    job->dst->lens[i] = units.size();
+    job->dst->rawLens[i] = len;
+    if (job->options->huffman) { // 在本线程中完成熵编码，之后不再需要三元组
+        huffmanEncodeLz77(units.data(), units.size(), job->dst->coded[i]);
+        vector<Lz77OutputUnit>().swap(units);
+    }
+    STAT(lzStatsBlock(lzStatsNow() - t0, len);)
 }
 
-void *_parallel_decompressLz77(void *args) {
-    DecompressLz77Args *xargs = (DecompressLz77Args*) args;
-    intptr_t len = _decompressLz77(*(xargs->src), *(xargs->dst), xargs->searchBufLen, xargs->lookAheadBufLen, xargs->t_id);
-    return (void*)len;
+int parallel_compressLz77(int num_t, const vector<char> &src, Lz77ParallelResult &dst, int searchBufLen, int lookAheadBufLen, const Lz77Options &options) {
+    return parallel_compressLz77(num_t, src.data(), src.size(), dst, searchBufLen, lookAheadBufLen, options);
 }
 
-int parallel_decompressLz77(const Lz77ParallelResult &src, vector<char> &dst, int searchBufLen, int lookAheadBufLen) {
-    // 分发参数
-    int num_t = src.lens.size();
-    DecompressLz77Args args[num_t];
-    vector<char> dsts[num_t];
+int parallel_compressLz77(int num_t, const char *src, int srcLen, Lz77ParallelResult &dst, int searchBufLen, int lookAheadBufLen, const Lz77Options &options) {
+    // 块数只由块长度决定，与线程数无关
+    int blockSize = options.blockSize > 0 ? options.blockSize : srcLen;
+    int n_block = std::max(1, (int)(((long long)srcLen + blockSize - 1) / blockSize));
 
-    for (int i = 0; i < num_t; ++i) {
-        args[i].t_id = i;
-        args[i].src = &(src.blocks[i]);
-        args[i].dst = &dsts[i];
-        args[i].searchBufLen = searchBufLen;
-        args[i].lookAheadBufLen = lookAheadBufLen;
-    }
+    dst.lens.assign(n_block, 0);
+    dst.rawLens.assign(n_block, 0);
+    dst.blocks.assign(n_block, vector<Lz77OutputUnit>());
+    dst.coded.clear();
+    if (options.huffman)
+        dst.coded.resize(n_block);
 
-    // 创建子线程
-    pthread_t threads[num_t];
+    ThreadPool &pool = ThreadPool::shared(num_t);
+    vector<Lz77Context> contexts(pool.size(), Lz77Context(searchBufLen, lookAheadBufLen, options));
+    dst.window = options.primeBlocks ? searchBufLen : 0;
+    CompressLz77Job job = {src, srcLen, blockSize > 0 ? blockSize : 1, dst.window, &dst, &contexts, &options};
+    pool.parallelFor(n_block, compressLz77Block, &job);
+
+    // 统计各块压缩结果长度之和
+    int len = 0;
+    for (int l : dst.lens)
+        len += l;
+    return len;
+}
+
+/*
+ * 将一块直接解压到输出中的最终位置，Huffman编码时先在本线程中解码三元组。
+ */
+static void decompressParallelBlock(void *arg, int i, int worker) {
+    DecompressLz77Job *job = (DecompressLz77Job*) arg;
+    STAT(uint64_t t0 = lzStatsNow();)
+    const Lz77ParallelResult &src = *job->src;
+    long long start = job->offsets[i], end = job->offsets[i + 1];
+    long long base = std::max(0LL, start - src.window);
 
-    for (int i = 0; i < num_t; ++i) {
-        int res_code = pthread_create(&threads[i], NULL, _parallel_decompressLz77, (void*)&args[i]);
-        if (res_code) return -1;
+    // 引用的历史数据可能跨越前面的多块，等待覆盖[base, start)的所有块
+    auto waitHistory = [&] {
+        pthread_mutex_lock(&job->lock);
+        for (int j = i - 1; j >= 0 && job->offsets[j + 1] > base; j--)
+            while (!job->done[j])
+                pthread_cond_wait(&job->doneCond, &job->lock);
+        pthread_mutex_unlock(&job->lock);
+    };
+    const vector<Lz77OutputUnit> *units = i < src.blocks.size() ? &src.blocks[i] : NULL;
+    if (i < src.coded.size()) {
+        units = &job->units[worker];
+        job->units[worker].clear();
+        if (huffmanDecodeLz77(src.coded[i].data(), src.coded[i].size(), job->units[worker]) < 0)
+            units = NULL;
     }
+    int len = job->failed || !units ? -1
+        : decompressLz77Block(units->data(), units->size(), job->dst + base, job->dst + start, job->dst + end, waitHistory);
+    if (len != end - start)
+        job->failed = true;
+    STAT(lzStatsBlock(lzStatsNow() - t0, end - start);)
+
+    // 出错时也标记完毕，避免后面的块一直等待
+    pthread_mutex_lock(&job->lock);
+    job->done[i] = 1;
+    pthread_cond_broadcast(&job->doneCond);
+    pthread_mutex_unlock(&job->lock);
+}
 
-    // 回收结果
-    for (int i = 0; i < num_t; ++i) {
-        void *retval;
-        if (pthread_join(threads[i], &retval)) return -1;
-        int _len = (intptr_t) retval;
-        // 将结果写到dst中
-        for (int j = 0; j < _len; ++j)
-            dst.push_back((*(args[i].dst))[j]);
+/*
+ * 各块在输出中的起始位置，最后一项为总长度。rawLens不完整或有负值时返回false。
+ */
+static bool blockOffsets(const Lz77ParallelResult &src, vector<long long> &offsets) {
+    int n_block = src.lens.size();
+    if (src.rawLens.size() != n_block || src.window < 0)
+        return false;
+    offsets.assign(n_block + 1, 0);
+    for (int i = 0; i < n_block; i++) {
+        if (src.rawLens[i] < 0)
+            return false;
+        offsets[i + 1] = offsets[i] + src.rawLens[i];
     }
+    return true;
+}
 
+int parallel_decompressLz77(int num_t, const Lz77ParallelResult &src, char *dst, size_t dstLen) {
+    int n_block = src.lens.size();
+    ThreadPool &pool = ThreadPool::shared(num_t);
+    DecompressLz77Job job;
+    job.src = &src;
+    if (!blockOffsets(src, job.offsets) || job.offsets[n_block] != dstLen || dstLen > INT32_MAX
+            || (src.coded.size() < n_block && src.blocks.size() < n_block))
+        return -1;
+    job.units.resize(pool.size());
+    job.dst = dst;
+    job.done.assign(n_block, 0);
+    job.failed = false;
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.doneCond, NULL);
+
+    pool.parallelFor(n_block, decompressParallelBlock, &job);
+
+    pthread_mutex_destroy(&job.lock);
+    pthread_cond_destroy(&job.doneCond);
+    return job.failed ? -1 : dstLen;
+}
+
+int parallel_decompressLz77(int num_t, const Lz77ParallelResult &src, vector<char> &dst) {
+    // 一次性分配输出空间，各块解压到各自的位置
+    vector<long long> offsets;
+    if (!blockOffsets(src, offsets) || dst.size() + offsets.back() > INT32_MAX)
+        return -1;
+    size_t before = dst.size();
+    dst.resize(before + offsets.back());
+    if (parallel_decompressLz77(num_t, src, dst.data() + before, offsets.back()) < 0) {
+        dst.resize(before);
+        return -1;
+    }
     return dst.size();
 }
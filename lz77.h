@@ -1,6 +1,7 @@
 #pragma once
 #include <cstring>
 #include <vector>
+#include "matchfinder.h"
 
 typedef short len_t;
 
@@ -8,13 +9,16 @@ struct Lz77OutputUnit {
     len_t offset; // 相对于buffer边界的偏移量
     len_t length; // 匹配长度
     char symbol; // 下一个不匹配字符
+
+    static const int SIZE = sizeof(len_t) * 2 + sizeof(char); // 写入缓冲区后占用的字节数
+
     int write(char *buf) {
         std::memcpy(buf, &offset, sizeof(offset));
         std::memcpy(buf + sizeof(offset), &length, sizeof(length));
         std::memcpy(buf + sizeof(offset) + sizeof(length), &symbol, sizeof(symbol));
         return sizeof(offset) + sizeof(length) + sizeof(symbol);
     }
-    int read(char *buf) {
+    int read(const char *buf) {
         std::memcpy(&offset, buf, sizeof(offset));
         std::memcpy(&length, buf + sizeof(offset), sizeof(length));
         std::memcpy(&symbol, buf + sizeof(offset) + sizeof(length), sizeof(symbol));
@@ -22,6 +26,28 @@ struct Lz77OutputUnit {
     }
 };
 
+/*
+ * LZ77压缩选项。除huffman外不影响输出格式，任何选项的压缩结果都可以由decompressLz77解压。
+ */
+struct Lz77Options {
+    int matchFinder = LZ77_MF_HASH_CHAIN; // 匹配查找方式，取值见Lz77MatchFinder
+    int chainDepth = 64;                  // 哈希链查找时每个位置至多比较的候选位置个数，二叉树查找不受此限制
+    bool huffman = false;                 // 并行压缩时是否在各线程中对三元组进行Huffman编码（见huffman.h），只影响parallel_compressLz77
+    int blockSize = 1 << 20;              // 并行压缩时每块的长度。块的划分与线程数无关，任何线程数下输出都相同
+    bool primeBlocks = true;              // 并行压缩时每块是否可以引用前一块末尾searchBufLen个符号，为false时各块完全独立
+    int lazy = 0;                         // 惰性匹配时最长匹配至多截短的符号数，0为贪心，见lz77.cpp中的encodeLz77
+    int niceLen = 0;                      // 找到这么长的匹配即停止查找并直接采用，0表示不限
+};
+
+/*
+ * 压缩等级1~9对应的选项：等级越高，查找越深、惰性匹配试探越多，压缩越慢、三元组越少。
+ * 只影响查找与选择匹配的方式，输出仍是同样的三元组，解压方法与参数都不变。level超出范围时取最近的等级。
+ *
+ * Returns:
+ *     返回以默认选项为基础、按等级修改了matchFinder、chainDepth、lazy与niceLen的选项。
+ */
+Lz77Options lz77Level(int level);
+
 /*
  * 使用LZ77算法压缩数据。
  * 算法假设search buffer与look ahead buffer长度均大于1。如果设置为1，有可能导致未知错误。
@@ -31,16 +57,22 @@ struct Lz77OutputUnit {
  *     dst : 压缩结果输出数组，每个元素表示一个三元组，详见LZ77算法原理。
  *     searchBufLen : LZ77算法参数，search buffer的长度。
  *     lookAheadBufLen : LZ77算法参数，look ahead buffer的长度。
+ *     options : 压缩选项，详见Lz77Options。
  *
  * Returns:
  *     正常情况下，函数返回输出长度（按输出元素个数计）。
  *     当压缩输出长度超过输出缓冲区长度时，函数返回-1。
  */
-int compressLz77(const std::vector<char> &src, std::vector<Lz77OutputUnit> &dst, int searchBufLen, int lookAheadBufLen);
+int compressLz77(const std::vector<char> &src, std::vector<Lz77OutputUnit> &dst, int searchBufLen, int lookAheadBufLen, const Lz77Options &options = Lz77Options());
+
+/*
+ * 压缩src起始的srcLen个符号，src可以指向内存映射的文件等任意内存区域。其他参数与上面的compressLz77相同。
+ */
+int compressLz77(const char *src, int srcLen, std::vector<Lz77OutputUnit> &dst, int searchBufLen, int lookAheadBufLen, const Lz77Options &options = Lz77Options());
 
 /*
  * 使用LZ77算法解压缩数据。
- * 参数意义与compressLz77相似。
+ * 参数意义与compressLz77相似。三元组自带偏移量与长度，searchBufLen与lookAheadBufLen不影响解压，只为与compressLz77对应而保留。
  *
  * Returns:
  *     正常情况下，函数返回输出长度（按输出元素个数计）。
@@ -48,20 +80,171 @@ int compressLz77(const std::vector<char> &src, std::vector<Lz77OutputUnit> &dst,
  */
 int decompressLz77(const std::vector<Lz77OutputUnit> &src, std::vector<char> &dst, int searchBufLen, int lookAheadBufLen);
 
+/*
+ * 计算src中srcLen个三元组解压后的长度（按符号个数计），可用于预先分配解压输出缓冲区。
+ *
+ * Returns:
+ *     返回解压后的长度，超过int表示范围时返回-1。
+ */
+int decompressedSizeLz77(const Lz77OutputUnit *src, int srcLen);
+
+/*
+ * 使用LZ77算法解压缩数据，直接写入调用者提供的缓冲区。
+ * 不重叠的匹配串整块复制，偏移量小于长度的重叠匹配串按周期成倍展开复制。
+ *
+ * Params:
+ *     src : 三元组数组。
+ *     srcLen : 三元组个数。
+ *     dst : 输出缓冲区。
+ *     dstLen : 输出缓冲区长度，通常由decompressedSizeLz77得到。
+ *     dictLen : dst之前已有的dictLen个符号可以被引用，与Lz77Context::compress的dictLen对应。
+ *
+ * Returns:
+ *     正常情况下，函数返回输出长度（按符号个数计）。
+ *     当解压输出长度超过输出缓冲区长度，或偏移量超出已解压的数据时，函数返回-1。
+ */
+int decompressLz77(const Lz77OutputUnit *src, int srcLen, char *dst, int dstLen, int dictLen = 0);
+
+/*
+ * LZ77编解码上下文
+ *
+ * 持有匹配查找器的索引，可以反复用于压缩多段互不相关的数据。查找器在后续调用中复用已分配的索引而不清空，
+ * 调用者复用dst（clear后容量保留）时，稳态下压缩与解压都不分配堆内存，适合大量小数据的场合。
+ * 各段数据独立压缩，输出与对每段分别调用compressLz77相同。
+ */
+class Lz77Context {
+public:
+    Lz77Context(int searchBufLen, int lookAheadBufLen, const Lz77Options &options = Lz77Options());
+
+    /*
+     * 压缩src起始的srcLen个符号，将三元组追加到dst。
+     * dictLen大于0时，src之前的dictLen个符号作为只读的字典，三元组可以引用其中的数据，但不为它们输出三元组。
+     *
+     * Returns:
+     *     返回dst的长度。
+     */
+    int compress(const char *src, int srcLen, std::vector<Lz77OutputUnit> &dst, int dictLen = 0);
+
+    /*
+     * 解压srcLen个三元组，将结果追加到dst。
+     *
+     * Returns:
+     *     正常情况下返回dst的长度，数据损坏时返回-1。
+     */
+    int decompress(const Lz77OutputUnit *src, int srcLen, std::vector<char> &dst);
+
+    /*
+     * 设置预置字典（如dict.h训练得到的字典），dictLen为0时取消。之后compress（dictLen为0时）与decompress
+     * 都以字典的最后searchBufLen个符号作为已有数据，短数据从第一个符号起就可以引用字典。压缩与解压须使用相同的字典。
+     * 哈希链查找时字典的索引只在此建立一次，各次压缩只读地共用它，只索引新数据；其他查找方式每次压缩时连同字典重新索引。
+     */
+    void setDictionary(const char *dict, int dictLen);
+
+private:
+    int searchBufLen;
+    int lookAheadBufLen;
+    Lz77Options options;
+    MatchFinder finder;
+    int presetLen;            // 预置字典的长度，0表示没有
+    MatchFinder presetFinder; // 预置字典的索引，只用于哈希链查找
+    std::vector<char> window; // 预置字典与本次的数据
+};
+
+/*
+ * 流式LZ77压缩
+ *
+ * 输入可以分多次给出，每次输出已能确定的三元组。内部只保留一个长度约为2 * searchBufLen + lookAheadBufLen的滑动窗口，
+ * 内存占用与输入总长度无关。输出与对全部输入调用compressLz77的结果完全相同。
+ */
+class Lz77StreamEncoder {
+public:
+    Lz77StreamEncoder(int searchBufLen, int lookAheadBufLen, const Lz77Options &options = Lz77Options());
+
+    /*
+     * 输入src中的srcLen个符号，将已能确定的三元组追加到dst。
+     *
+     * Returns:
+     *     返回本次输出的三元组个数。
+     */
+    int update(const char *src, int srcLen, std::vector<Lz77OutputUnit> &dst);
+
+    /*
+     * 输入结束，将剩余的三元组追加到dst。之后编码器回到初始状态，可以压缩新的数据。
+     *
+     * Returns:
+     *     返回本次输出的三元组个数。
+     */
+    int finish(std::vector<Lz77OutputUnit> &dst);
+
+private:
+    int encode(bool final, std::vector<Lz77OutputUnit> &dst);
+
+    int searchBufLen;
+    int lookAheadBufLen;
+    Lz77Options options;
+    int windowSize;          // 每次滑动的距离
+    std::vector<char> window; // 滑动窗口
+    int pos;                 // look ahead buffer最左符号在window中的下标
+    int end;                 // window中数据的结束位置
+    MatchFinder finder;
+};
+
+/*
+ * 流式LZ77解压
+ *
+ * 三元组可以分多次给出，每次输出已解压的数据。内部只保留最近searchBufLen个符号作为历史数据。
+ */
+class Lz77StreamDecoder {
+public:
+    Lz77StreamDecoder(int searchBufLen, int lookAheadBufLen);
+
+    /*
+     * 输入src中的srcLen个三元组，将解压结果追加到dst。
+     *
+     * Returns:
+     *     正常情况下，返回本次输出的符号个数。
+     *     当三元组引用了历史数据以外的位置，或匹配长度超过lookAheadBufLen时，返回-1。
+     */
+    int update(const Lz77OutputUnit *src, int srcLen, std::vector<char> &dst);
+
+private:
+    int searchBufLen;
+    int lookAheadBufLen;
+    std::vector<char> history; // 历史数据
+    int end;                   // history中数据的结束位置
+};
+
 /*
  * 并行压缩返回结果
  */
 struct Lz77ParallelResult {
-    std::vector<int> lens;
-    std::vector<std::vector<Lz77OutputUnit>> blocks;
+    int window = 0;                                  // 每块可以引用其起始位置之前的多少个符号，0表示各块独立
+    std::vector<int> lens;                           // 各块的三元组个数
+    std::vector<int> rawLens;                        // 各块解压后的长度，解压时据此直接确定每块在输出中的位置
+    std::vector<std::vector<Lz77OutputUnit>> blocks; // 各块的三元组
+    std::vector<std::vector<char>> coded; // 开启Huffman编码时，各块编码后的字节，此时blocks中不保留三元组
 };
 
 /**
  * 并行压缩，除了增加表示并行度的num_t参数外，其他参数与compressLz77相同。
+ * 输入按options.blockSize分块，由常驻线程池（见threadpool.h）中的num_t个线程压缩，每块对应dst中的一个元素。
+ * options.primeBlocks为true时，与pigz类似，每块把它之前的searchBufLen个输入符号当作字典，跨块的匹配不会丢失。
  */
-int parallel_compressLz77(int num_t, const std::vector<char> &src, Lz77ParallelResult &dst, int searchBufLen, int lookAheadBufLen);
+int parallel_compressLz77(int num_t, const std::vector<char> &src, Lz77ParallelResult &dst, int searchBufLen, int lookAheadBufLen, const Lz77Options &options = Lz77Options());
+int parallel_compressLz77(int num_t, const char *src, int srcLen, Lz77ParallelResult &dst, int searchBufLen, int lookAheadBufLen, const Lz77Options &options = Lz77Options());
 
 /**
- * 并行解压，除了增加表示并行度的num_t参数外，其他参数与decompressLz77相同。
+ * 并行解压，由num_t个线程解压src，结果追加到dst。各块的长度与可引用的范围都记录在src中，不需要再给出LZ77参数。
+ * src.coded非空时，各线程先解码Huffman编码的三元组再解压。
+ * 输出长度由src.rawLens给出，一次性分配后各块直接解压到最终位置，不再拼接。
+ * src.window大于0时，一块第一次引用它之前的数据时，等待前面的块解压完毕。
+ */
+int parallel_decompressLz77(int num_t, const Lz77ParallelResult &src, std::vector<char> &dst);
+
+/**
+ * 并行解压到调用者提供的缓冲区（如映射的输出文件），dstLen须等于src.rawLens之和。
+ *
+ * Returns:
+ *     正常情况下返回输出长度，数据损坏时返回-1。
  */
-int parallel_decompressLz77(const Lz77ParallelResult &src, std::vector<char> &dst, int searchBufLen, int lookAheadBufLen);
+int parallel_decompressLz77(int num_t, const Lz77ParallelResult &src, char *dst, size_t dstLen);
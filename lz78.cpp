@@ -3,49 +3,47 @@
 #include <cstring>
 #include <cmath>
 
+#include "bitio.h"
 #include "lz78.h"
-
-#define N_SYMBOLS 256
-
-typedef unsigned char sym_t;
+#include "stats.h"
+#include "threadpool.h"
+#include "trie.h"
 
 /*
- * 字典树
- *
- * 在预先开辟的数组上实现字典树。数组相当于内存，int型数组下标相当于指针。
+ * 将字典树恢复到压缩开始时的状态：有预置字典时撤销到字典建立的快照，否则清空为只有根节点。
  */
-template <int N>
-struct Node {
-    int parent; // 父节点指针，这一字段在压缩时不会用到
-    sym_t symbol; // 从父节点到当前节点的边上的符号。尽管这一字段可以从父节点计算得到，但保存在此效率更高。这一字段在压缩时不会用到
-    int child[N]; // 各子节点指针，去往第i个子节点的边上符号为i
-};
+void Lz78Context::resetTree() {
+    if (treeBase > 0)
+        tree.rollback(treeBase);
+    else
+        tree.init(dictSize);
+}
 
-int compressLz78(const vector<char> &src, vector<Lz78OutputUnit> &dst, int dictSize) {
-    // 建立字典树
-    Node<N_SYMBOLS> *tree = new Node<N_SYMBOLS>[dictSize];
-    memset(tree, -1, sizeof(Node<N_SYMBOLS>) * dictSize); // 全部指针初始化为-1，表示空指针
-    int root = 0;
-    int treeSize = 1; // 初始时树中只有根节点
+int Lz78Context::compress(const char *src, int srcLen, vector<Lz78OutputUnit> &dst) {
+    resetTree();
+    int root = 0; // 初始时树中只有根节点，或是预置字典的快照
+
+    STAT(size_t before = dst.size();)
 
     // 压缩阶段
     int pos = 0; // 当前下标
-    while (pos < src.size()) {
+    while (pos < srcLen) {
         // 在字典树中匹配
         int node = root;
-        for (; pos < src.size(); pos++) {
+        for (; pos < srcLen; pos++) {
             sym_t c = src[pos];
-            if (tree[node].child[c] == -1) break;
-            node = tree[node].child[c];
+            int child = tree.find(node, c);
+            if (child == -1) break;
+            node = child;
         }
 
         // 此时node指向应当输出的节点下标，或者说字典下标
         // 但不确定循环是由于输入结束而退出还是因为查到新词而退出
-        if (pos < src.size()) { // 因发现新词而退出
+        if (pos < srcLen) { // 因发现新词而退出
             sym_t c = src[pos];
-            // 向树中加入新节点，其中parent字段压缩时无用，因此不写
-            if (treeSize < dictSize)
-                tree[node].child[c] = treeSize++;
+            // 向树中加入新节点
+            if (tree.size() < dictSize)
+                tree.add(node, c);
             // 输出
             dst.push_back(Lz78OutputUnit(node, c));
             pos++;  // 移动pos
@@ -54,42 +52,269 @@ int compressLz78(const vector<char> &src, vector<Lz78OutputUnit> &dst, int dictS
             dst.push_back(Lz78OutputUnit(-node, 0)); // 没有未匹配字符时，输出的index为负值，以此作为特殊标记
         }
     }
+    STAT_ADD(lz78_units, dst.size() - before);
+    STAT_ADD(lz78_lookups, srcLen); // 每个符号恰好查找一次：或沿已有的边前进，或查找失败后作为未匹配字符输出
+    STAT_ADD(lz78_nodes, tree.size() - presetSize());
+    STAT_MAX(trie_fill_max, (uint64_t)tree.size() * 1000 / dictSize);
 
     return dst.size();
 }
 
+Lz78Context::Lz78Context(int dictSize) : dictSize(dictSize), dictLen(0), treeBase(0), phraseBase(0) {}
+
+void Lz78Context::setDictionary(const char *dict, int dictLen) {
+    treeBase = phraseBase = 0;
+    this->dictLen = 0;
+    window.clear();
+    if (dictLen <= 0)
+        return;
+    // 压缩一遍字典，得到的字典树即快照；再解压同样的单元，短语表中的位置指向window中的字典
+    vector<Lz78OutputUnit> units;
+    compress(dict, dictLen, units);
+    treeBase = tree.size();
+    resetPhrases();
+    decode(units.data(), units.size(), window, 0);
+    phraseBase = phrases.size();
+    this->dictLen = dictLen;
+}
+
+/*
+ * 将短语表恢复到解压开始时的状态，与resetTree对应。
+ */
+void Lz78Context::resetPhrases() {
+    if (phraseBase > 0) {
+        phrases.rollback(phraseBase);
+        return;
+    }
+    phrases.init(dictSize);
+    phrases.add(0, 0); // 根节点为空串
+}
+
+int Lz78Context::presetSize() const {
+    return std::max(treeBase, 1);
+}
+
+int compressLz78(const char *src, int srcLen, vector<Lz78OutputUnit> &dst, int dictSize) {
+    return Lz78Context(dictSize).compress(src, srcLen, dst);
+}
+
+int compressLz78(const vector<char> &src, vector<Lz78OutputUnit> &dst, int dictSize) {
+    return compressLz78(src.data(), src.size(), dst, dictSize);
+}
+
+int Lz78Context::decompress(const Lz78OutputUnit *src, int srcLen, vector<char> &dst) {
+    resetPhrases();
+    if (dictLen == 0)
+        return decode(src, srcLen, dst, dst.size());
+    // 有预置字典时解压到window中字典之后，短语表中字典的短语可以直接引用
+    window.resize(dictLen);
+    if (decode(src, srcLen, window, 0) < 0)
+        return -1;
+    dst.insert(dst.end(), window.begin() + dictLen, window.end());
+    return dst.size();
+}
+
+int Lz78Context::decompress(const Lz78OutputUnit *src, int srcLen, char *dst, int dstLen) {
+    resetPhrases();
+    if (dictLen > 0) { // 短语表中字典的短语在window中，解压到window后再复制
+        window.resize(dictLen);
+        if (decode(src, srcLen, window, 0, (long long)dictLen + dstLen) < 0)
+            return -1;
+        std::memcpy(dst, window.data() + dictLen, window.size() - dictLen);
+        return window.size() - dictLen;
+    }
+    long long end = measure(src, srcLen, 0, dstLen);
+    if (end < 0)
+        return -1;
+    copy(src, srcLen, dst, 0);
+    return end;
+}
+
+/*
+ * 解压srcLen个单元追加到dst，短语表中的位置以dst中下标origin处为起点。输出的结束位置（相对于origin）超过limit
+ * 或dst的长度超过int表示范围时返回-1。
+ */
+int Lz78Context::decode(const Lz78OutputUnit *src, int srcLen, vector<char> &dst, size_t origin, long long limit) {
+    size_t base = dst.size();
+    long long end = measure(src, srcLen, base - origin, std::min<long long>(limit, INT32_MAX - (long long)origin));
+    if (end < 0)
+        return -1;
+    dst.resize(origin + end);
+    copy(src, srcLen, dst.data() + origin, base - origin);
+    return dst.size();
+}
+
+/*
+ * 解压的第一遍：只算长度，建立短语表。有未匹配字符的单元加入的新短语就是该单元的输出。
+ * pos为输出的起始位置（相对于短语表中位置的起点），结束位置超过limit时返回-1。
+ *
+ * Returns:
+ *     正常情况下返回输出的结束位置，数据损坏时返回-1。
+ */
+long long Lz78Context::measure(const Lz78OutputUnit *src, int srcLen, long long pos, long long limit) {
+    for (int i = 0; i < srcLen; i++) {
+        int index = src[i].index, node = std::abs(index);
+        if (node < 0 || node >= phrases.size())
+            return -1;
+        int len = phrases.length(node) + (index >= 0);
+        if (index >= 0 && phrases.size() < dictSize)
+            phrases.add(pos, len);
+        pos += len;
+        if (pos > limit)
+            return -1;
+    }
+    return pos;
+}
+
+/*
+ * 解压的第二遍：复制短语，再写出未匹配字符。out为短语表中位置的起点，从out + pos起写出。
+ * 引用的短语都在当前位置之前，不会重叠。
+ */
+void Lz78Context::copy(const Lz78OutputUnit *src, int srcLen, char *out, long long pos) {
+    STAT(long long start = pos;)
+    for (int i = 0; i < srcLen; i++) {
+        int node = std::abs(src[i].index), len = phrases.length(node);
+        std::memcpy(out + pos, out + phrases.offset(node), len);
+        pos += len;
+        if (src[i].index >= 0)
+            out[pos++] = src[i].symbol;
+    }
+    STAT_ADD(lz78_decoded_units, srcLen);
+    STAT_ADD(lz78_decoded_bytes, pos - start);
+}
+
 int decompressLz78(const vector<Lz78OutputUnit> &src, vector<char> &dst, int dictSize) {
-    // 建立字典树
-    Node<N_SYMBOLS> *tree = new Node<N_SYMBOLS>[dictSize];
-    memset(tree, -1, sizeof(Node<N_SYMBOLS>) * dictSize); // 全部指针初始化为-1，表示空指针
-    int root = 0;
-    int treeSize = 1; // 初始时树中只有根节点
-
-    // 解压阶段
-    for (int i = 0; i < src.size(); i++) {
-        // 首先将codeword逆序输出，因为已知字典下标时只能通过parent字段逆序遍历整个codeword
-        int wordLen = 0; // 记录当前codeword的长度
-        for (int node = std::abs(src[i].index); node != root; node = tree[node].parent) {
-            dst.push_back(tree[node].symbol);
-            wordLen++;
+    return Lz78Context(dictSize).decompress(src.data(), src.size(), dst);
+}
+
+int packLz78(const Lz78OutputUnit *src, int srcLen, int dictSize, vector<char> &out) {
+    return packLz78(src, srcLen, dictSize, out, 0);
+}
+
+int packLz78(const Lz78OutputUnit *src, int srcLen, int dictSize, vector<char> &out, int presetSize) {
+    presetSize = std::max(presetSize, 1);
+    size_t before = out.size();
+    uint32_t header = srcLen;
+    out.insert(out.end(), (char *)&header, (char *)&header + sizeof(header));
+
+    BitWriter writer(out);
+    bool noSymbol = srcLen > 0 && src[srcLen - 1].index < 0;
+    writer.put(noSymbol, 1);
+    for (int k = 0; k < srcLen; k++) {
+        int width = bitWidth(std::min(presetSize - 1 + k, dictSize - 1)); // 第k个单元之前字典中至多有presetSize + k项
+        writer.put(std::abs(src[k].index), width);
+        if (src[k].index >= 0)
+            writer.put((sym_t)src[k].symbol, 8);
+    }
+    writer.flush();
+    return out.size() - before;
+}
+
+int unpackLz78(const char *buf, size_t bufLen, int dictSize, vector<Lz78OutputUnit> &dst) {
+    return unpackLz78(buf, bufLen, dictSize, dst, 0);
+}
+
+int unpackLz78(const char *buf, size_t bufLen, int dictSize, vector<Lz78OutputUnit> &dst, int presetSize) {
+    presetSize = std::max(presetSize, 1);
+    uint32_t n;
+    if (bufLen < sizeof(n) || dictSize < 1)
+        return -1;
+    std::memcpy(&n, buf, sizeof(n));
+    if (n > (bufLen - sizeof(n)) * 8) // 每个单元至少占1位
+        return -1;
+
+    BitReader reader(buf + sizeof(n), bufLen - sizeof(n));
+    bool noSymbol = reader.get(1);
+    size_t base = dst.size();
+    dst.resize(base + n);
+    Lz78OutputUnit *out = dst.data() + base;
+    uint32_t k = 0;
+    for (; k < n; k++) {
+        int maxIndex = std::min<uint32_t>(presetSize - 1 + k, dictSize - 1);
+        int index = reader.get(bitWidth(maxIndex));
+        if (index > maxIndex)
+            break;
+        if (noSymbol && k + 1 == n) {
+            out[k] = Lz78OutputUnit(-index, 0);
+        } else {
+            out[k] = Lz78OutputUnit(index, reader.get(8));
         }
-        // 然后再将刚刚输出的codeword逆转过来
-        reverse(dst.end() - wordLen, dst.end());
-        // 有未匹配字符时，在输出末尾添加未匹配字符
-        if (src[i].index >= 0) {
-            dst.push_back(src[i].symbol);
-            // 更新字典树，插入新节点
-            if (treeSize < dictSize) {
-                int newnode = treeSize++;
-                int parent = std::abs(src[i].index); // 即将成为父节点的节点
-                sym_t c = src[i].symbol; // 未匹配字符
-                tree[parent].child[c] = newnode;
-                tree[newnode].parent = parent;
-                tree[newnode].symbol = c;
-            }
+    }
+    if (k != n || reader.overrun()) {
+        dst.resize(base);
+        return -1;
+    }
+    return n;
+}
+
+static const LzBlockCodec<Lz78OutputUnit> blockCodecLz78 = {packLz78, unpackLz78};
+
+int parallel_compressLz78(int num_t, const char *src, int srcLen, LzBlockResult &dst, int dictSize, int blockSize) {
+    return parallelCompressLzBlocks<Lz78Context>(num_t, src, srcLen, dst, dictSize, blockSize, blockCodecLz78);
+}
+
+int parallel_decompressLz78(int num_t, const LzBlockResult &src, char *dst, size_t dstLen, int dictSize) {
+    return parallelDecompressLzBlocks<Lz78Context>(num_t, src, dst, dstLen, dictSize, blockCodecLz78);
+}
+
+#define LZ78_DECODE_SEGMENT (1 << 14) // 并行解压时每段的单元个数
+
+struct DecompressLz78Job {
+    const Lz78OutputUnit *src;
+    int srcLen;
+    const int *phraseLens;     // 各字典项的短语长度
+    const int64_t *positions;  // 各单元在输出中的位置，最后一项为总长度
+    char *dst;
+};
+
+static void decompressLz78Segment(void *arg, int seg, int worker) {
+    DecompressLz78Job *job = (DecompressLz78Job *)arg;
+    int lo = seg * LZ78_DECODE_SEGMENT, hi = std::min(job->srcLen, lo + LZ78_DECODE_SEGMENT);
+    STAT(uint64_t t0 = lzStatsNow();)
+    for (int i = lo; i < hi; i++) {
+        char *out = job->dst + job->positions[i];
+        int node = std::abs(job->src[i].index);
+        int len = job->phraseLens[node];
+        if (node - 1 >= lo) { // 第node项的短语就是第node - 1个单元的输出，已由本段写出
+            std::memcpy(out, job->dst + job->positions[node - 1], len);
+        } else { // 第node项的父节点即第node - 1个单元的下标
+            for (char *w = out + len; node != 0; node = job->src[node - 1].index)
+                *--w = job->src[node - 1].symbol;
         }
-        // 无未匹配字符时，输入也应当遍历结束了
+        if (job->src[i].index >= 0)
+            out[len] = job->src[i].symbol;
+    }
+    STAT(lzStatsBlock(lzStatsNow() - t0, job->positions[hi] - job->positions[lo]);)
+    STAT_ADD(lz78_decoded_units, hi - lo);
+    STAT_ADD(lz78_decoded_bytes, job->positions[hi] - job->positions[lo]);
+}
+
+int parallel_decompressLz78Stream(int num_t, const Lz78OutputUnit *src, int srcLen, vector<char> &dst, int dictSize) {
+    if (dictSize < 1)
+        return -1;
+    // 第一遍：各短语长度与各单元的输出位置，同时检查下标
+    int nodes = std::min(srcLen, dictSize - 1); // 加入字典的项数
+    vector<int> phraseLens(nodes + 1);
+    vector<int64_t> positions(srcLen + 1);
+    phraseLens[0] = 0;
+    positions[0] = 0;
+    for (int i = 0; i < srcLen; i++) {
+        int index = src[i].index, node = std::abs(index);
+        if (node > std::min(i, dictSize - 1) || (index < 0 && i + 1 != srcLen))
+            return -1;
+        int len = phraseLens[node] + (index >= 0);
+        if (index >= 0 && i + 1 < dictSize)
+            phraseLens[i + 1] = len;
+        positions[i + 1] = positions[i] + len;
     }
+    if (dst.size() + positions[srcLen] > INT32_MAX)
+        return -1;
 
+    // 第二遍：分段并行展开
+    size_t base = dst.size();
+    dst.resize(base + positions[srcLen]);
+    DecompressLz78Job job = {src, srcLen, phraseLens.data(), positions.data(), dst.data() + base};
+    int nSegments = (srcLen + LZ78_DECODE_SEGMENT - 1) / LZ78_DECODE_SEGMENT;
+    ThreadPool::shared(num_t).parallelFor(nSegments, decompressLz78Segment, &job);
     return dst.size();
 }
@@ -1,27 +1,33 @@
 #pragma once
+#include <cstdint>
 #include <cstring>
 #include <vector>
 
+#include "blockcodec.h"
+#include "trie.h"
+
 using namespace std;
 
-typedef short len_t;
+typedef int32_t idx_t; // 字典下标，32位以支持数百万项的字典
 
 struct Lz78OutputUnit {
-    len_t index; // 匹配词在字典中的下标
+    idx_t index; // 匹配词在字典中的下标
     char symbol; // 下一个不匹配字符
 
-    Lz78OutputUnit(int index, char symbol) {
+    Lz78OutputUnit(int index = 0, char symbol = 0) {
         this->index = index;
         this->symbol = symbol;
     }
 
+    static const int SIZE = sizeof(idx_t) + sizeof(char); // 写入缓冲区后占用的字节数
+
     int write(char *buf) {
         std::memcpy(buf, &index, sizeof(index));
         std::memcpy(buf + sizeof(index), &symbol, sizeof(symbol));
         return sizeof(index) + sizeof(symbol);
     }
 
-    int read(char *buf) {
+    int read(const char *buf) {
         std::memcpy(&index, buf, sizeof(index));
         std::memcpy(&symbol, buf + sizeof(index), sizeof(symbol));
         return sizeof(index) + sizeof(symbol);
@@ -43,6 +49,11 @@ struct Lz78OutputUnit {
  */
 int compressLz78(const vector<char> &src, vector<Lz78OutputUnit> &dst, int dictSize);
 
+/*
+ * 压缩src起始的srcLen个符号，src可以指向内存映射的文件等任意内存区域。其他参数与上面的compressLz78相同。
+ */
+int compressLz78(const char *src, int srcLen, vector<Lz78OutputUnit> &dst, int dictSize);
+
 /*
  * 使用LZ78算法解压缩数据。
  * 参数意义与compressLz78相似。
@@ -53,3 +64,128 @@ int compressLz78(const vector<char> &src, vector<Lz78OutputUnit> &dst, int dictS
  */
 int decompressLz78(const vector<Lz78OutputUnit> &src, vector<char> &dst, int dictSize);
 
+
+/*
+ * LZ78编解码上下文
+ *
+ * 持有压缩用的字典树与解压用的短语表，可以反复用于压缩或解压多段互不相关的数据。再次使用时只撤销上次加入字典的节点，
+ * 代价与上次的数据量成正比，不重新分配内存；调用者复用dst（clear后容量保留）时，稳态下不分配堆内存。
+ * 各段数据独立编码，结果与对每段分别调用compressLz78相同。
+ */
+class Lz78Context {
+public:
+    /*
+     * dictSize: 字典大小，压缩与解压时须相同。
+     */
+    explicit Lz78Context(int dictSize);
+
+    /*
+     * 压缩src起始的srcLen个符号，将输出单元追加到dst。
+     *
+     * Returns:
+     *     返回dst的长度。
+     */
+    int compress(const char *src, int srcLen, vector<Lz78OutputUnit> &dst);
+
+    /*
+     * 解压srcLen个输出单元，将结果追加到dst。每个单元从已解压的数据中复制一次短语。
+     *
+     * Returns:
+     *     正常情况下返回dst的长度，下标越界等数据损坏时返回-1，此时dst不变。
+     */
+    int decompress(const Lz78OutputUnit *src, int srcLen, vector<char> &dst);
+
+    /*
+     * 解压srcLen个输出单元，直接写入调用者提供的缓冲区dst，输出超过dstLen时在写入前即返回-1。
+     *
+     * Returns:
+     *     正常情况下返回输出长度，输出超过dstLen或数据损坏时返回-1。
+     */
+    int decompress(const Lz78OutputUnit *src, int srcLen, char *dst, int dstLen);
+
+    /*
+     * 设置预置字典（如dict.h训练得到的字典），dictLen为0时取消。
+     * 先把dict当作一段数据压缩、解压一遍，得到的字典树与短语表作为快照，之后每次压缩、解压都从快照开始，
+     * 结束后只撤销新加入的项，代价与本次的数据量成正比。压缩与解压须使用相同的字典与dictSize。
+     */
+    void setDictionary(const char *dict, int dictLen);
+
+    /*
+     * 每次压缩开始时字典中的项数，即快照的大小，没有预置字典时为1（根节点）。按位打包时传给packLz78与unpackLz78。
+     */
+    int presetSize() const;
+
+private:
+    void resetTree();
+    void resetPhrases();
+    int decode(const Lz78OutputUnit *src, int srcLen, vector<char> &dst, size_t origin, long long limit = INT32_MAX);
+    long long measure(const Lz78OutputUnit *src, int srcLen, long long pos, long long limit);
+    void copy(const Lz78OutputUnit *src, int srcLen, char *out, long long pos);
+
+    int dictSize;
+    Trie tree;           // 压缩用
+    PhraseTable phrases; // 解压用
+    int dictLen;         // 预置字典的长度，0表示没有
+    int treeBase;        // 字典树快照的节点数，0表示没有快照
+    int phraseBase;      // 短语表快照的项数
+    vector<char> window; // 预置字典与解压输出，短语表中的位置相对于它的起点
+};
+
+/*
+ * 将LZ78输出单元按位紧凑写出，追加到out末尾。
+ * 第k个单元（从0开始）的下标不超过min(k, dictSize - 1)，因此只用表示该值所需的位数写出，
+ * 随着字典增长，码宽从0位逐渐增加到dictSize - 1所需的位数；未匹配字符占8位。
+ * 格式为[u32 单元个数][1位：最后一个单元没有未匹配字符][各单元]。
+ * 有预置字典时presetSize为Lz78Context::presetSize()，第k个单元的下标不超过min(presetSize - 1 + k, dictSize - 1)。
+ *
+ * Returns:
+ *     返回写入的字节数。
+ */
+int packLz78(const Lz78OutputUnit *src, int srcLen, int dictSize, vector<char> &out);
+int packLz78(const Lz78OutputUnit *src, int srcLen, int dictSize, vector<char> &out, int presetSize);
+
+/*
+ * 读入由packLz78写出的数据，将输出单元追加到dst。dictSize与presetSize须与压缩时相同。
+ *
+ * Returns:
+ *     返回读出的单元个数。数据损坏时返回-1。
+ */
+int unpackLz78(const char *buf, size_t bufLen, int dictSize, vector<Lz78OutputUnit> &dst);
+int unpackLz78(const char *buf, size_t bufLen, int dictSize, vector<Lz78OutputUnit> &dst, int presetSize);
+
+/*
+ * 分块并行压缩，各块使用独立的字典，块的划分与线程数无关（见blockcodec.h）。
+ *
+ * Params:
+ *     num_t : 线程数。
+ *     blockSize : 每块的长度。
+ *     其余参数与compressLz78相同。
+ *
+ * Returns:
+ *     返回块数。
+ */
+int parallel_compressLz78(int num_t, const char *src, int srcLen, LzBlockResult &dst, int dictSize, int blockSize);
+
+/*
+ * 分块并行解压到dst，dstLen须等于src.rawLens之和。
+ *
+ * Returns:
+ *     正常情况下返回输出长度，数据损坏时返回-1。
+ */
+int parallel_decompressLz78(int num_t, const LzBlockResult &src, char *dst, size_t dstLen, int dictSize);
+
+/*
+ * 并行解压单个LZ78流（未分块的压缩结果），输出与decompressLz78相同。
+ *
+ * 第i个单元（带未匹配字符时）在字典中加入第i + 1项，该项的短语恰好是第i个单元的输出。
+ * 先串行计算各短语长度（父短语长度 + 1）并求前缀和，得到每个单元在输出中的位置；
+ * 再将单元分段并行展开：父短语的那次出现位于同一段内（已写出）时直接复制，否则沿父节点从后向前写出。
+ *
+ * Params:
+ *     num_t : 线程数。
+ *     其余参数与decompressLz78相同，结果追加到dst。
+ *
+ * Returns:
+ *     正常情况下返回dst的长度，数据损坏时返回-1。
+ */
+int parallel_decompressLz78Stream(int num_t, const Lz78OutputUnit *src, int srcLen, vector<char> &dst, int dictSize);
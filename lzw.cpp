@@ -3,48 +3,51 @@
 #include <cstring>
 #include <vector>
 
+#include "bitio.h"
 #include "lzw.h"
-
-#define N_SYMBOLS 256
-
-typedef unsigned char sym_t;
+#include "stats.h"
+#include "trie.h"
 
 using std::vector;
 
 /*
- * 字典树
- *
- * 在预先开辟的数组上实现字典树。数组相当于内存，int型数组下标相当于指针。
+ * 字典中至少要放下根节点与全部单字符，更小的dictSize按此下限处理。
  */
+static inline int clampDictSize(int dictSize) {
+    return std::max(dictSize, 1 + N_SYMBOLS);
+}
 
-template <int N>
-struct Node {
-    int parent; // 父节点指针，这一字段在压缩时不会用到
-    sym_t symbol; // 从父节点到当前节点的边上的符号。尽管这一字段可以从父节点计算得到，但保存在此效率更高。这一字段在压缩时不会用到
-    int child[N]; // 各子节点指针，去往第i个子节点的边上符号为i
-};
-
-int compressLzW(const vector<char> &src, vector<LzWOutputUnit> &dst, int dictSize) {
-    // 建立字典树
-    Node<N_SYMBOLS> *tree = new Node<N_SYMBOLS>[dictSize];
-    memset(tree, -1, sizeof(Node<N_SYMBOLS>) * dictSize); // 全部指针初始化为-1，表示空指针
-    int root = 0;
+/*
+ * 将字典树恢复到压缩开始时的状态：有预置字典时撤销到字典建立的快照，否则重新建立只含单字符的树。
+ */
+void LzWContext::resetTree() {
+    if (treeBase > 0) {
+        tree.rollback(treeBase);
+        return;
+    }
+    tree.init(dictSize);
     for(int i = 0; i < N_SYMBOLS; ++i){ //初始化一个带N个单字符的字典树。
-        tree[0].child[i] = i + 1;
-        tree[i + 1].parent = 0;
-        tree[i + 1].symbol = i;
+        tree.add(0, i);
     }
-    int treeSize = 1 + N_SYMBOLS; // 初始时树中只有根节点，和初始化的N个节点，共N+1个节点
+    // 初始时树中只有根节点，和初始化的N个节点，共N+1个节点
+}
+
+int LzWContext::compress(const char *src, int srcLen, vector<LzWOutputUnit> &dst) {
+    resetTree();
+    int root = 0;
+
+    STAT(size_t before = dst.size(); uint64_t misses = 0;)
 
     // 压缩阶段
     int pos = 0; // 当前下标
-    while (pos < src.size()) {
+    while (pos < srcLen) {
         // 在字典树中匹配
         int node = root;
-        for (; pos < src.size(); pos++) {
+        for (; pos < srcLen; pos++) {
             sym_t c = src[pos];
-            if (tree[node].child[c] == -1) break;
-            node = tree[node].child[c];
+            int child = tree.find(node, c);
+            if (child == -1) break;
+            node = child;
         }
         // 此时node指向应当输出的节点下标，或者说字典下标
         LzWOutputUnit newUnit;
@@ -53,68 +56,236 @@ int compressLzW(const vector<char> &src, vector<LzWOutputUnit> &dst, int dictSiz
 
         // 但之前不确定循环是由于输入结束而退出还是因为查到新词而退出
         // 如果是查到新词而退出，那么需要把新词加到字典里去
-        if (pos < src.size()) { // 因发现新词而退出
+        if (pos < srcLen) { // 因发现新词而退出
             sym_t c = src[pos];
+            STAT(misses++;)
             // 向树中加入新节点
-            if (treeSize < dictSize){
-                tree[node].child[c] = treeSize++;
-                tree[treeSize - 1].parent = node;
-                tree[treeSize - 1].symbol = c;
+            if (tree.size() < dictSize){
+                tree.add(node, c);
             }
         }
         // 如果是输入结束了，就结束了。
     }
+    STAT_ADD(lzw_units, dst.size() - before);
+    STAT_ADD(lzw_lookups, srcLen + misses); // 每个符号查找一次，另加每个短语末尾查找失败的一次
+    STAT_ADD(lzw_nodes, tree.size() - std::max(treeBase, 1 + N_SYMBOLS));
+    STAT_MAX(trie_fill_max, (uint64_t)tree.size() * 1000 / dictSize);
     return dst.size();
 }
 
+LzWContext::LzWContext(int dictSize) : dictSize(clampDictSize(dictSize)), dictLen(0), treeBase(0), phraseBase(0) {}
 
+void LzWContext::setDictionary(const char *dict, int dictLen) {
+    treeBase = phraseBase = 0;
+    this->dictLen = 0;
+    window.clear();
+    if (dictLen <= 0)
+        return;
+    // 压缩一遍字典，得到的字典树即快照；再解压同样的单元，短语表中的位置指向window中的字典
+    vector<LzWOutputUnit> units;
+    compress(dict, dictLen, units);
+    treeBase = tree.size();
+    resetPhrases();
+    decode(units.data(), units.size(), window, 0);
+    phraseBase = phrases.size();
+    this->dictLen = dictLen;
+}
 
-int decompressLzW(const vector<LzWOutputUnit> &src, vector<char> &dst, int dictSize) {
-    // 建立字典树
-    Node<N_SYMBOLS> *tree = new Node<N_SYMBOLS>[dictSize]; // 目前仅实现2-ary输入上的压缩
-    memset(tree, -1, sizeof(Node<N_SYMBOLS>) * dictSize); // 全部指针初始化为-1，表示空指针
-    int root = 0;
-    for(int i = 0; i < N_SYMBOLS; ++i){ //初始化一个带N个单字符的字典树。
-        tree[0].child[i] = i + 1;
-        tree[i + 1].parent = 0;
-        tree[i + 1].symbol = i;
+/*
+ * 将短语表恢复到解压开始时的状态，与resetTree对应。
+ */
+void LzWContext::resetPhrases() {
+    if (phraseBase > 0) {
+        phrases.rollback(phraseBase);
+        return;
     }
-    int treeSize = 1 + N_SYMBOLS; // 初始时树中只有根节点，和初始化的N个节点，共N+1个节点
-
-    // 解压阶段
-    int last_node = 0;
-    for (int i = 0; i < src.size(); i++) {
-        // 首先将codeword逆序输出，因为已知字典下标时只能通过parent字段逆序遍历整个codeword
-        int wordLen = 0; // 记录当前codeword的长度
-        sym_t first_sym = 0; // 记录当前codeword的第一个字符
-
-        int node;
-        if (src[i].index >= treeSize){ // 如果当前node没在字典里面找到, 那么该node的字符串对应上一个node的加上一个新字符
-            node = last_node;
-        }else{
-            node = src[i].index;
-        }
-        for (; node != root; node = tree[node].parent) {
-            dst.push_back(tree[node].symbol);
-            first_sym = tree[node].symbol;
-            wordLen++;
-        }
-        // 然后再将刚刚输出的codeword逆转过来
-        std::reverse(dst.end() - wordLen, dst.end());
-        if (src[i].index >= treeSize){
-          dst.push_back(first_sym);
-        }
+    // 短语表的前N_SYMBOLS + 1项为根节点与单字符，不在输出中，解压时直接写出符号
+    phrases.init(dictSize);
+    for (int i = 0; i <= N_SYMBOLS; i++)
+        phrases.add(0, i > 0);
+}
 
-        if (last_node != 0) { // 不是第一个节点，前一个codeword加当前codeword的第一个字符，就是新字符串，插入字典树
-            if (treeSize < dictSize) { // 如果字典树没有满
-                int newnode = treeSize++;
-                tree[last_node].child[first_sym] = newnode;
-                tree[newnode].parent = last_node;
-                tree[newnode].symbol = first_sym;
-            }
-        }
-        last_node = src[i].index; // 将当前node设置为last_node
+int LzWContext::presetSize() const {
+    return std::max(treeBase, 1 + N_SYMBOLS);
+}
+
+int compressLzW(const char *src, int srcLen, vector<LzWOutputUnit> &dst, int dictSize) {
+    return LzWContext(dictSize).compress(src, srcLen, dst);
+}
+
+int compressLzW(const vector<char> &src, vector<LzWOutputUnit> &dst, int dictSize) {
+    return compressLzW(src.data(), src.size(), dst, dictSize);
+}
+
+
+
+int LzWContext::decompress(const LzWOutputUnit *src, int srcLen, vector<char> &dst) {
+    resetPhrases();
+    if (dictLen == 0)
+        return decode(src, srcLen, dst, dst.size());
+    // 有预置字典时解压到window中字典之后，短语表中字典的短语可以直接引用
+    window.resize(dictLen);
+    if (decode(src, srcLen, window, 0) < 0)
+        return -1;
+    dst.insert(dst.end(), window.begin() + dictLen, window.end());
+    return dst.size();
+}
+
+int LzWContext::decompress(const LzWOutputUnit *src, int srcLen, char *dst, int dstLen) {
+    resetPhrases();
+    if (dictLen > 0) { // 短语表中字典的短语在window中，解压到window后再复制
+        window.resize(dictLen);
+        if (decode(src, srcLen, window, 0, (long long)dictLen + dstLen) < 0)
+            return -1;
+        std::memcpy(dst, window.data() + dictLen, window.size() - dictLen);
+        return window.size() - dictLen;
     }
-    // 无未匹配字符时，输入也应当遍历结束了
+    int known = phrases.size();
+    long long end = measure(src, srcLen, 0, dstLen);
+    if (end < 0)
+        return -1;
+    copy(src, srcLen, dst, 0, known);
+    return end;
+}
+
+/*
+ * 解压srcLen个单元追加到dst，短语表中的位置以dst中下标origin处为起点。输出的结束位置（相对于origin）超过limit
+ * 或dst的长度超过int表示范围时返回-1。
+ */
+int LzWContext::decode(const LzWOutputUnit *src, int srcLen, vector<char> &dst, size_t origin, long long limit) {
+    int known = phrases.size(); // 解压开始时短语表中的项数，第二遍使用
+    size_t base = dst.size();
+    long long end = measure(src, srcLen, base - origin, std::min<long long>(limit, INT32_MAX - (long long)origin));
+    if (end < 0)
+        return -1;
+    dst.resize(origin + end);
+    copy(src, srcLen, dst.data() + origin, base - origin, known);
     return dst.size();
 }
+
+/*
+ * 解压的第一遍：只算长度，建立短语表。pos为输出的起始位置（相对于短语表中位置的起点），结束位置超过limit时返回-1。
+ * 第i个单元（i > 0）加入的新短语是前一单元的输出再加当前输出的首字符，在输出中恰好从前一单元的起点开始，长度多1。
+ * 下标恰为尚未加入的那一项时（KwKwK），当前输出就是这个新短语。
+ *
+ * Returns:
+ *     正常情况下返回输出的结束位置，数据损坏时返回-1。
+ */
+long long LzWContext::measure(const LzWOutputUnit *src, int srcLen, long long pos, long long limit) {
+    long long prevStart = 0;
+    int prevLen = 0;
+    for (int i = 0; i < srcLen; i++) {
+        int index = src[i].index;
+        // 下标0为根节点，不会出现在输出中；下标至多是下一个将要加入的项，第一个单元没有前一短语
+        if (index <= 0 || index > phrases.size() || (index == phrases.size() && i == 0))
+            return -1;
+        int len = index < phrases.size() ? phrases.length(index) : prevLen + 1;
+        if (i > 0 && phrases.size() < dictSize)
+            phrases.add(prevStart, prevLen + 1);
+        prevStart = pos;
+        prevLen = len;
+        pos += len;
+        if (pos > limit)
+            return -1;
+    }
+    return pos;
+}
+
+/*
+ * 解压的第二遍：按measure建立的短语表复制，out为短语表中位置的起点，从out + pos起写出。
+ * known为measure之前短语表中的项数。
+ */
+void LzWContext::copy(const LzWOutputUnit *src, int srcLen, char *out, long long pos, int known) {
+    STAT(long long start = pos;)
+    long long prevStart = 0;
+    int prevLen = 0;
+    for (int i = 0; i < srcLen; i++) {
+        int index = src[i].index, len;
+        if (index >= known) { // KwKwK：前一短语再加其首字符
+            std::memcpy(out + pos, out + prevStart, prevLen);
+            out[pos + prevLen] = out[prevStart];
+            len = prevLen + 1;
+        } else if (index > N_SYMBOLS) {
+            len = phrases.length(index);
+            std::memcpy(out + pos, out + phrases.offset(index), len);
+        } else {
+            out[pos] = index - 1;
+            len = 1;
+        }
+        if (i > 0 && known < dictSize)
+            known++;
+        prevStart = pos;
+        prevLen = len;
+        pos += len;
+    }
+    STAT_ADD(lzw_decoded_units, srcLen);
+    STAT_ADD(lzw_decoded_bytes, pos - start);
+}
+
+int decompressLzW(const vector<LzWOutputUnit> &src, vector<char> &dst, int dictSize) {
+    return LzWContext(dictSize).decompress(src.data(), src.size(), dst);
+}
+
+int packLzW(const LzWOutputUnit *src, int srcLen, int dictSize, vector<char> &out) {
+    return packLzW(src, srcLen, dictSize, out, 0);
+}
+
+int packLzW(const LzWOutputUnit *src, int srcLen, int dictSize, vector<char> &out, int presetSize) {
+    dictSize = clampDictSize(dictSize);
+    presetSize = std::max(presetSize, 1 + N_SYMBOLS);
+    size_t before = out.size();
+    uint32_t header = srcLen;
+    out.insert(out.end(), (char *)&header, (char *)&header + sizeof(header));
+
+    BitWriter writer(out);
+    for (int k = 0; k < srcLen; k++) {
+        // 输出第k个单元时字典中至多有presetSize + k项
+        int width = bitWidth(std::min(presetSize - 1 + k, dictSize - 1));
+        writer.put(src[k].index, width);
+    }
+    writer.flush();
+    return out.size() - before;
+}
+
+int unpackLzW(const char *buf, size_t bufLen, int dictSize, vector<LzWOutputUnit> &dst) {
+    return unpackLzW(buf, bufLen, dictSize, dst, 0);
+}
+
+int unpackLzW(const char *buf, size_t bufLen, int dictSize, vector<LzWOutputUnit> &dst, int presetSize) {
+    dictSize = clampDictSize(dictSize);
+    presetSize = std::max(presetSize, 1 + N_SYMBOLS);
+    uint32_t n;
+    if (bufLen < sizeof(n))
+        return -1;
+    std::memcpy(&n, buf, sizeof(n));
+    if (n > (bufLen - sizeof(n)) * 8 / 9) // 每个单元至少占9位
+        return -1;
+
+    BitReader reader(buf + sizeof(n), bufLen - sizeof(n));
+    size_t base = dst.size();
+    dst.resize(base + n);
+    LzWOutputUnit *out = dst.data() + base;
+    uint32_t k = 0;
+    for (; k < n; k++) {
+        int maxIndex = std::min<uint32_t>(presetSize - 1 + k, dictSize - 1);
+        int index = reader.get(bitWidth(maxIndex));
+        if (index > maxIndex)
+            break;
+        out[k].index = index;
+    }
+    if (k != n || reader.overrun()) {
+        dst.resize(base);
+        return -1;
+    }
+    return n;
+}
+
+static const LzBlockCodec<LzWOutputUnit> blockCodecLzW = {packLzW, unpackLzW};
+
+int parallel_compressLzW(int num_t, const char *src, int srcLen, LzBlockResult &dst, int dictSize, int blockSize) {
+    return parallelCompressLzBlocks<LzWContext>(num_t, src, srcLen, dst, dictSize, blockSize, blockCodecLzW);
+}
+
+int parallel_decompressLzW(int num_t, const LzBlockResult &src, char *dst, size_t dstLen, int dictSize) {
+    return parallelDecompressLzBlocks<LzWContext>(num_t, src, dst, dstLen, dictSize, blockCodecLzW);
+}
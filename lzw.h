@@ -1,18 +1,24 @@
 #pragma once
+#include <cstdint>
 #include <cstring>
 #include <vector>
 
-typedef short len_t;
+#include "blockcodec.h"
+#include "trie.h"
+
+typedef int32_t idx_t; // 字典下标，32位以支持数百万项的字典
 
 struct LzWOutputUnit {
-    len_t index; // 匹配词在字典中的下标
+    idx_t index; // 匹配词在字典中的下标
+
+    static const int SIZE = sizeof(idx_t); // 写入缓冲区后占用的字节数
 
     int write(char *buf) {
         std::memcpy(buf, &index, sizeof(index));
         return sizeof(index);
     }
 
-    int read(char *buf) {
+    int read(const char *buf) {
         std::memcpy(&index, buf, sizeof(index));
         return sizeof(index);
     }
@@ -25,7 +31,7 @@ struct LzWOutputUnit {
  * Params:
  *     src : 输入数组，每个元素表示源数据中的1个符号（目前按照1个bit来实现，即符号集中只有0和1。是否可以优化成支持其它进制符号集？）。
  *     dst : 压缩结果输出数组，每个元素表示一个三元组，详见LZ78算法原理。
- *     dictSize: LZW算法参数，字典大小（entry最大数量）。
+ *     dictSize: LZW算法参数，字典大小（entry最大数量）。小于257时按257处理，以放下根节点与全部单字符。
  *
  * Returns:
  *     正常情况下，函数返回输出长度（按输出元素个数计）。
@@ -33,6 +39,11 @@ struct LzWOutputUnit {
  */
 int compressLzW(const std::vector<char> &src, std::vector<LzWOutputUnit> &dst, int dictSize);
 
+/*
+ * 压缩src起始的srcLen个符号，src可以指向内存映射的文件等任意内存区域。其他参数与上面的compressLzW相同。
+ */
+int compressLzW(const char *src, int srcLen, std::vector<LzWOutputUnit> &dst, int dictSize);
+
 /*
  * 使用LZW算法解压缩数据。
  * 参数意义与compressLzW相似。
@@ -43,3 +54,111 @@ int compressLzW(const std::vector<char> &src, std::vector<LzWOutputUnit> &dst, i
  */
 int decompressLzW(const std::vector<LzWOutputUnit> &src, std::vector<char> &dst, int dictSize);
 
+
+/*
+ * LZW编解码上下文
+ *
+ * 持有压缩用的字典树与解压用的短语表，可以反复用于压缩或解压多段互不相关的数据。再次使用时只撤销上次加入字典的节点，
+ * 代价与上次的数据量成正比，不重新分配内存；调用者复用dst（clear后容量保留）时，稳态下不分配堆内存。
+ * 各段数据独立编码，结果与对每段分别调用compressLzW相同。
+ */
+class LzWContext {
+public:
+    /*
+     * dictSize: 字典大小，压缩与解压时须相同。小于257时按257处理。
+     */
+    explicit LzWContext(int dictSize);
+
+    /*
+     * 压缩src起始的srcLen个符号，将输出单元追加到dst。
+     *
+     * Returns:
+     *     返回dst的长度。
+     */
+    int compress(const char *src, int srcLen, std::vector<LzWOutputUnit> &dst);
+
+    /*
+     * 解压srcLen个输出单元，将结果追加到dst。每个单元从已解压的数据中复制一次短语。
+     *
+     * Returns:
+     *     正常情况下返回dst的长度，下标越界等数据损坏时返回-1，此时dst不变。
+     */
+    int decompress(const LzWOutputUnit *src, int srcLen, std::vector<char> &dst);
+
+    /*
+     * 解压srcLen个输出单元，直接写入调用者提供的缓冲区dst，输出超过dstLen时在写入前即返回-1。
+     *
+     * Returns:
+     *     正常情况下返回输出长度，输出超过dstLen或数据损坏时返回-1。
+     */
+    int decompress(const LzWOutputUnit *src, int srcLen, char *dst, int dstLen);
+
+    /*
+     * 设置预置字典（如dict.h训练得到的字典），dictLen为0时取消。
+     * 先把dict当作一段数据压缩、解压一遍，得到的字典树与短语表作为快照，之后每次压缩、解压都从快照开始，
+     * 结束后只撤销新加入的项，代价与本次的数据量成正比。压缩与解压须使用相同的字典与dictSize。
+     */
+    void setDictionary(const char *dict, int dictLen);
+
+    /*
+     * 每次压缩开始时字典中的项数，即快照的大小，没有预置字典时为N_SYMBOLS + 1。按位打包时传给packLzW与unpackLzW。
+     */
+    int presetSize() const;
+
+private:
+    void resetTree();
+    void resetPhrases();
+    int decode(const LzWOutputUnit *src, int srcLen, std::vector<char> &dst, size_t origin, long long limit = INT32_MAX);
+    long long measure(const LzWOutputUnit *src, int srcLen, long long pos, long long limit);
+    void copy(const LzWOutputUnit *src, int srcLen, char *out, long long pos, int known);
+
+    int dictSize;
+    Trie tree;           // 压缩用
+    PhraseTable phrases; // 解压用
+    int dictLen;               // 预置字典的长度，0表示没有
+    int treeBase;              // 字典树快照的节点数，0表示没有快照
+    int phraseBase;            // 短语表快照的项数
+    std::vector<char> window;  // 预置字典与解压输出，短语表中的位置相对于它的起点
+};
+
+/*
+ * 将LZW输出单元按位紧凑写出，追加到out末尾。
+ * 与经典LZW相同，码宽随字典大小增长：第k个单元（从0开始）的下标不超过min(256 + k, dictSize - 1)，
+ * 因此从9位开始，字典每翻一倍码宽加1位。格式为[u32 单元个数][各单元]。
+ * 有预置字典时presetSize为LzWContext::presetSize()，第k个单元的下标不超过min(presetSize - 1 + k, dictSize - 1)。
+ *
+ * Returns:
+ *     返回写入的字节数。
+ */
+int packLzW(const LzWOutputUnit *src, int srcLen, int dictSize, std::vector<char> &out);
+int packLzW(const LzWOutputUnit *src, int srcLen, int dictSize, std::vector<char> &out, int presetSize);
+
+/*
+ * 读入由packLzW写出的数据，将输出单元追加到dst。dictSize与presetSize须与压缩时相同。
+ *
+ * Returns:
+ *     返回读出的单元个数。数据损坏时返回-1。
+ */
+int unpackLzW(const char *buf, size_t bufLen, int dictSize, std::vector<LzWOutputUnit> &dst);
+int unpackLzW(const char *buf, size_t bufLen, int dictSize, std::vector<LzWOutputUnit> &dst, int presetSize);
+
+/*
+ * 分块并行压缩，各块使用独立的字典，块的划分与线程数无关（见blockcodec.h）。
+ *
+ * Params:
+ *     num_t : 线程数。
+ *     blockSize : 每块的长度。
+ *     其余参数与compressLzW相同。
+ *
+ * Returns:
+ *     返回块数。
+ */
+int parallel_compressLzW(int num_t, const char *src, int srcLen, LzBlockResult &dst, int dictSize, int blockSize);
+
+/*
+ * 分块并行解压到dst，dstLen须等于src.rawLens之和。
+ *
+ * Returns:
+ *     正常情况下返回输出长度，数据损坏时返回-1。
+ */
+int parallel_decompressLzW(int num_t, const LzBlockResult &src, char *dst, size_t dstLen, int dictSize);
@@ -4,22 +4,38 @@
 #include <string>
 #include <unistd.h>
 #include <memory>
+#include <algorithm>
 
+#include "codec.h"
+#include "container.h"
 #include "lz77.h"
 #include "lz78.h"
 #include "lzw.h"
+#include "fileio.h"
+#include "huffman.h"
+#include "ldm.h"
+#include "pipeline.h"
+#include "stats.h"
 
 using namespace std;
 
-const char *usage = "Usage: main.exe -[7|8|p|w] -[C|D] -n <n_thread> --sb <searchBufLen> --lb <lookAheadBufLen> --ds <dictSize> -i <input_file> -o <output_file>";
+const char *usage = "Usage: main.exe -[7|8|p|w] -[C|D] [-e] -n <n_thread> --sb <searchBufLen> --lb <lookAheadBufLen> --mf <brute|hc|bt> --depth <chainDepth> --level <1-9> [--long <windowMB>] [--dict <dict_file>] --bs <blockSize> --ds <dictSize> [--pipe] [--range <offset>:<length>] [--stats] -i <input_file> -o <output_file>";
 
 int compress = 0; // 0->undefined,  1->compress, 2->decompress
 int method = 0;   // 0->undefined,  1->LZ77,     2->LZ78,      3->LZ77 parallel, 4-> LZW
 bool verbose = 0;
 int searchBufLen = 2;
 int lookAheadBufLen = 2;
+Lz77Options lz77Options;
 int dictSize = 2;
 int n_thread = 1;
+bool pipe_mode = false; // 以流水线方式分块读入、压缩、写出
+long long range_begin = -1, range_len = 0; // 只解压原始数据中的这一段，仅用于容器格式
+bool show_stats = false; // 结束时输出计数器，需以make DEFS=-DLZ_STATS编译
+const char *dict_file = NULL; // 预置字典（见dict.h，由build/train训练），用于-7、-8、-w
+int long_window = 0; // 大于0时-7使用长距离匹配（见ldm.h），长匹配的偏移量至多为这么多MB
+
+#define STREAM_CHUNK_SIZE (1 << 20) // 流式处理时每次读取的字节数
 
 char* input_file = NULL;
 char* output_file = NULL;
@@ -73,11 +89,36 @@ int parse_arg(int argc, char *argv[]) {
         }
         else if (!strcmp(arg, "--sb") && argv[i+1][0] != '-') searchBufLen = stoi(argv[++i]);
         else if (!strcmp(arg, "--lb") && argv[i+1][0] != '-') lookAheadBufLen = stoi(argv[++i]);
+        else if (!strcmp(arg, "--mf") && argv[i+1][0] != '-') {
+            char *mf = argv[++i];
+            if (!strcmp(mf, "brute")) lz77Options.matchFinder = LZ77_MF_BRUTE;
+            else if (!strcmp(mf, "hc")) lz77Options.matchFinder = LZ77_MF_HASH_CHAIN;
+            else if (!strcmp(mf, "bt")) lz77Options.matchFinder = LZ77_MF_BINARY_TREE;
+            else unknown_arg_err();
+        }
+        else if (!strcmp(arg, "--depth") && argv[i+1][0] != '-') lz77Options.chainDepth = stoi(argv[++i]);
+        else if (!strcmp(arg, "--level") && argv[i+1][0] != '-') { // 只设置查找相关的选项，其后的--mf、--depth可以覆盖
+            Lz77Options level = lz77Level(stoi(argv[++i]));
+            lz77Options.matchFinder = level.matchFinder;
+            lz77Options.chainDepth = level.chainDepth;
+            lz77Options.lazy = level.lazy;
+            lz77Options.niceLen = level.niceLen;
+        }
+        else if (!strcmp(arg, "--dict") && argv[i+1][0] != '-') dict_file = argv[++i];
+        else if (!strcmp(arg, "--long") && argv[i+1][0] != '-') long_window = stoi(argv[++i]);
         else if (!strcmp(arg, "--ds") && argv[i+1][0] != '-') dictSize = stoi(argv[++i]);
         else if (!strcmp(arg, "-n") && argv[i+1][0] != '-') n_thread = atoi(argv[++i]);
         else if (!strcmp(arg, "-i") && argv[i+1][0] != '-') input_file = argv[++i];
         else if (!strcmp(arg, "-o") && argv[i+1][0] != '-') output_file = argv[++i];
-        else if (!strcmp(arg, "-v")) verbose = true;
+        else if (!strcmp(arg, "--bs") && argv[i+1][0] != '-') lz77Options.blockSize = stoi(argv[++i]);
+        else if (!strcmp(arg, "-e")) lz77Options.huffman = true;
+        else if (!strcmp(arg, "--pipe")) pipe_mode = true;
+        else if (!strcmp(arg, "--range") && argv[i+1][0] != '-') {
+            if (sscanf(argv[++i], "%lld:%lld", &range_begin, &range_len) != 2 || range_begin < 0 || range_len < 0)
+                unknown_arg_err();
+        }
+        else if (!strcmp(arg, "-v")) verbose = show_stats = true;
+        else if (!strcmp(arg, "--stats")) show_stats = true;
         else if (!strcmp(arg, "-h") || !strcmp(arg, "--help")) show_usage();
         else unknown_arg_err();
     }
@@ -114,152 +155,577 @@ int get_file_size(const char *filename) {
     return (int)(end - begin);
 }
 
+/*
+ * 从buf中读出len个字节的输出单元。
+ */
+template <typename Unit>
+void read_units(const char *buf, size_t len, vector<Unit> &units) {
+    units.resize(len / Unit::SIZE, Unit());
+    for (Unit &u : units)
+        buf += u.read(buf);
+}
+
+/*
+ * 流式LZ77压缩：分块输入映射的文件，边压缩边写出，内存占用与文件大小无关。
+ */
+bool stream_compressLz77(const MappedFile &inFile, OutputFile &outFile) {
+    Lz77StreamEncoder encoder(searchBufLen, lookAheadBufLen, lz77Options);
+    vector<Lz77OutputUnit> units;
+    vector<char> outChunk;
+    for (size_t pos = 0; pos <= inFile.size(); pos += STREAM_CHUNK_SIZE) {
+        int n = std::min(inFile.size() - pos, (size_t)STREAM_CHUNK_SIZE);
+        units.clear();
+        if (n > 0)
+            encoder.update(inFile.data() + pos, n, units);
+        if (pos + n == inFile.size())
+            encoder.finish(units);
+        int len = 0;
+        if (lz77Options.huffman) {
+            outChunk.clear();
+            len = huffmanEncodeLz77(units.data(), units.size(), outChunk);
+        } else {
+            outChunk.resize(Lz77OutputUnit::SIZE * units.size());
+            for (auto u : units)
+                len += u.write(outChunk.data() + len);
+        }
+        if (!outFile.write(outChunk.data(), len))
+            return false;
+    }
+    return true;
+}
+
+/*
+ * 流式LZ77解压：分块读取三元组，边解压边写出。
+ *
+ * Returns:
+ *     输入损坏或写入失败时返回false。
+ */
+bool stream_decompressLz77(const MappedFile &inFile, OutputFile &outFile) {
+    Lz77StreamDecoder decoder(searchBufLen, lookAheadBufLen);
+    const int chunkUnits = STREAM_CHUNK_SIZE / Lz77OutputUnit::SIZE; // 每块的三元组个数
+    vector<Lz77OutputUnit> units;
+    vector<char> outChunk;
+    size_t pos = 0;
+    while (pos < inFile.size()) {
+        units.clear();
+        if (lz77Options.huffman) { // 每次解码一个Huffman块
+            int n = huffmanDecodeLz77Block(inFile.data() + pos, std::min(inFile.size() - pos, (size_t)INT32_MAX), units);
+            if (n < 0)
+                return false;
+            pos += n;
+        } else {
+            size_t n = std::min((inFile.size() - pos) / Lz77OutputUnit::SIZE, (size_t)chunkUnits);
+            if (n == 0)
+                break;
+            read_units(inFile.data() + pos, n * Lz77OutputUnit::SIZE, units);
+            pos += n * Lz77OutputUnit::SIZE;
+        }
+        outChunk.clear();
+        if (decoder.update(units.data(), units.size(), outChunk) < 0)
+            return false;
+        if (!outFile.write(outChunk.data(), outChunk.size()))
+            return false;
+    }
+    return true;
+}
+
+/*
+ * 载入预置字典后把整个输入当作一块压缩或解压（见BlockCoder）。输出格式与不用字典时-7、-8、-w单线程的输出相同，
+ * 但解压时须给出同一个字典。
+ *
+ * Returns:
+ *     字典无法读入、输入损坏或写入失败时返回false。
+ */
+bool code_with_dictionary(const char *inBuffer, size_t inSize, OutputFile &outFile) {
+    MappedFile dict;
+    if (!dict.open(dict_file) || dict.size() > INT32_MAX || inSize > INT32_MAX)
+        return false;
+    int codec = method == 2 ? CODEC_LZ78 : method == 4 ? CODEC_LZW : CODEC_LZ77;
+    BlockCoder coder(codec, searchBufLen, lookAheadBufLen, lz77Options, dictSize);
+    coder.setDictionary(dict.data(), dict.size());
+    vector<char> out;
+    if (compress == 1)
+        coder.compress(inBuffer, inSize, out);
+    else if (coder.decompress(inBuffer, inSize, out) < 0)
+        return false;
+    return outFile.write(out.data(), out.size());
+}
+
+/*
+ * 写出长距离匹配的压缩结果：[长匹配个数][三元组个数][各长匹配][三元组]。Huffman编码时第二项为三元组编码后的字节数。
+ */
+bool write_long(OutputFile &outFile, Lz77LongResult &dst) {
+    int header[2] = {(int)dst.matches.size(), (int)dst.units.size()};
+    size_t unitBytes = lz77Options.huffman ? 0 : Lz77OutputUnit::SIZE * dst.units.size();
+    vector<char> out(sizeof(header) + Lz77LongUnit::SIZE * dst.matches.size() + unitBytes);
+    char *p = out.data() + sizeof(header);
+    for (const Lz77LongUnit &m : dst.matches)
+        p += m.write(p);
+    if (lz77Options.huffman) {
+        header[1] = huffmanEncodeLz77(dst.units.data(), dst.units.size(), out);
+    } else {
+        for (Lz77OutputUnit &u : dst.units)
+            p += u.write(p);
+    }
+    memcpy(out.data(), header, sizeof(header));
+    return outFile.write(out.data(), out.size());
+}
+
+/*
+ * 读入write_long写出的数据。
+ *
+ * Returns:
+ *     数据不完整或损坏时返回false。
+ */
+bool read_long(const char *inBuffer, size_t inSize, Lz77LongResult &src) {
+    int header[2];
+    if (inSize < sizeof(header))
+        return false;
+    memcpy(header, inBuffer, sizeof(header));
+    size_t pos = sizeof(header);
+    if (header[0] < 0 || header[1] < 0 || (inSize - pos) / Lz77LongUnit::SIZE < (size_t)header[0])
+        return false;
+    src.matches.resize(header[0]);
+    for (Lz77LongUnit &m : src.matches)
+        pos += m.read(inBuffer + pos);
+    if (lz77Options.huffman)
+        return inSize - pos == (size_t)header[1] && huffmanDecodeLz77(inBuffer + pos, header[1], src.units) >= 0;
+    if ((inSize - pos) / Lz77OutputUnit::SIZE < (size_t)header[1])
+        return false;
+    read_units(inBuffer + pos, Lz77OutputUnit::SIZE * header[1], src.units);
+    return true;
+}
+
+/*
+ * 将输出单元序列化到映射的输出文件中，header为写在最前面的headerLen个字节。
+ */
+template <typename Unit>
+bool write_units(OutputFile &outFile, const char *header, size_t headerLen, const vector<vector<Unit>> &blocks) {
+    size_t len = headerLen;
+    for (auto &v : blocks)
+        len += Unit::SIZE * v.size();
+    if (len == 0)
+        return true;
+    char *out = outFile.map(len);
+    if (!out)
+        return false;
+    memcpy(out, header, headerLen);
+    out += headerLen;
+    for (auto &v : blocks)
+        for (Unit u : v)
+            out += u.write(out);
+    return true;
+}
+
+/*
+ * 读入-p格式的块头与各块数据，格式见main中的压缩部分。
+ *
+ * Returns:
+ *     数据不完整时返回false。
+ */
+bool read_parallel_header(const char *inBuffer, size_t inSize, Lz77ParallelResult &src) {
+    size_t pos = 0;
+    int n = 0; // 块数
+    if (inSize < sizeof(int) * 2)
+        return false;
+    memcpy(&n, inBuffer, sizeof(n));
+    memcpy(&src.window, inBuffer + sizeof(n), sizeof(src.window));
+    pos += sizeof(int) * 2;
+    if (n < 0 || (inSize - pos) / (sizeof(int) * 2) < (size_t)n)
+        return false;
+    src.rawLens.resize(n);
+    memcpy(src.rawLens.data(), inBuffer + pos, sizeof(int) * n);
+    pos += sizeof(int) * n;
+    src.lens.resize(n);
+    memcpy(src.lens.data(), inBuffer + pos, sizeof(int) * n);
+    pos += sizeof(int) * n;
+
+    // Huffman编码时lens为各块字节数，之后由各线程解码
+    size_t unitSize = lz77Options.huffman ? 1 : Lz77OutputUnit::SIZE;
+    for (int i = 0; i < n; i++) {
+        size_t len = unitSize * (unsigned)src.lens[i];
+        if (src.lens[i] < 0 || inSize - pos < len)
+            return false;
+        if (lz77Options.huffman) {
+            src.coded.emplace_back(inBuffer + pos, inBuffer + pos + len);
+        } else {
+            src.blocks.emplace_back();
+            read_units(inBuffer + pos, len, src.blocks.back());
+        }
+        pos += len;
+    }
+    return true;
+}
+
+/*
+ * 写出LZ78/LZW分块并行压缩的结果：[-块数][各块解压后的长度][各块字节数][各块数据]。
+ * 块数取负值，以便与单个打包流（开头为非负的单元个数）区分。
+ */
+bool write_lz_blocks(OutputFile &outFile, const LzBlockResult &dst) {
+    vector<int> header;
+    header.push_back(-(int)dst.rawLens.size());
+    header.insert(header.end(), dst.rawLens.begin(), dst.rawLens.end());
+    for (auto &v : dst.packed)
+        header.push_back(v.size());
+    bool ok = outFile.write(header.data(), sizeof(int) * header.size());
+    for (auto &v : dst.packed)
+        ok = ok && outFile.write(v.data(), v.size());
+    return ok;
+}
+
+/*
+ * 判断输入是否为write_lz_blocks写出的分块格式。
+ */
+bool is_lz_blocks(const char *inBuffer, size_t inSize) {
+    int n = 0;
+    if (inSize < sizeof(n))
+        return false;
+    memcpy(&n, inBuffer, sizeof(n));
+    return n < 0;
+}
+
+/*
+ * 读入write_lz_blocks写出的块头与各块数据。
+ *
+ * Returns:
+ *     数据不完整时返回false。
+ */
+bool read_lz_blocks(const char *inBuffer, size_t inSize, LzBlockResult &src) {
+    int n = 0;
+    memcpy(&n, inBuffer, sizeof(n));
+    n = -n;
+    size_t pos = sizeof(n);
+    if (n <= 0 || (inSize - pos) / (sizeof(int) * 2) < (size_t)n)
+        return false;
+    src.rawLens.resize(n);
+    memcpy(src.rawLens.data(), inBuffer + pos, sizeof(int) * n);
+    pos += sizeof(int) * n;
+    vector<int> lens(n);
+    memcpy(lens.data(), inBuffer + pos, sizeof(int) * n);
+    pos += sizeof(int) * n;
+    for (int i = 0; i < n; i++) {
+        if (lens[i] < 0 || inSize - pos < (size_t)lens[i])
+            return false;
+        src.packed.emplace_back(inBuffer + pos, inBuffer + pos + lens[i]);
+        pos += lens[i];
+    }
+    return pos == inSize;
+}
+
+/*
+ * 分块并行解压LZ78/LZW：输出长度已知，直接映射输出文件，各块解压到最终位置。
+ */
+template <class Decompress>
+bool decompress_lz_blocks(const char *inBuffer, size_t inSize, OutputFile &outFile, Decompress decompress) {
+    LzBlockResult src;
+    if (!read_lz_blocks(inBuffer, inSize, src))
+        return false;
+    size_t total = 0;
+    for (int len : src.rawLens)
+        total += len;
+    char *out = total ? outFile.map(total) : NULL;
+    return (total == 0 || out) && decompress(n_thread, src, out, total, dictSize) >= 0;
+}
+
+/*
+ * 流水线模式（--pipe）
+ *
+ * 读线程每次读入--bs个字节，-n个工作线程各自独立压缩一块，主线程按顺序写出，输出为容器格式（见container.h）。
+ * 解压时读线程逐帧读入，同样由工作线程解压、检查校验和，主线程按顺序写出。
+ */
+struct PipeJob {
+    InputFile in;
+    OutputFile out;
+    ContainerHeader header;
+    vector<BlockCoder> coders;    // 每个工作线程一个
+    vector<ContainerBlock> index; // 已写出的各帧的帧头
+};
+
+int pipe_read_raw(void *arg, vector<char> &block) {
+    PipeJob *job = (PipeJob *)arg;
+    block.resize(job->header.blockSize);
+    long long n = job->in.read(block.data(), block.size());
+    if (n <= 0)
+        return n < 0 ? -1 : 0;
+    block.resize(n);
+    return 1;
+}
+
+int pipe_read_frame(void *arg, vector<char> &block) {
+    PipeJob *job = (PipeJob *)arg;
+    ContainerBlock frame;
+    block.resize(ContainerBlock::SIZE);
+    if (job->in.read(block.data(), block.size()) != ContainerBlock::SIZE)
+        return -1;
+    frame.read(block.data());
+    if (frame.rawLen == CONTAINER_END) // 之后是索引，顺序解压时不需要
+        return 0;
+    if (frame.rawLen > INT32_MAX || frame.codedLen > INT32_MAX)
+        return -1;
+    block.resize(ContainerBlock::SIZE + frame.codedLen);
+    return job->in.read(block.data() + ContainerBlock::SIZE, frame.codedLen) == frame.codedLen ? 1 : -1;
+}
+
+bool pipe_compress_block(void *arg, int worker, const vector<char> &in, vector<char> &out) {
+    PipeJob *job = (PipeJob *)arg;
+    encodeContainerFrame(job->coders[worker], in.data(), in.size(), out);
+    return true;
+}
+
+bool pipe_decompress_block(void *arg, int worker, const vector<char> &in, vector<char> &out) {
+    PipeJob *job = (PipeJob *)arg;
+    ContainerBlock frame;
+    frame.read(in.data());
+    return decodeContainerFrame(job->coders[worker], frame, in.data() + ContainerBlock::SIZE, out);
+}
+
+bool pipe_write(void *arg, const vector<char> &block) {
+    PipeJob *job = (PipeJob *)arg;
+    if (compress == 1) { // 记录帧头，最后写出索引
+        job->index.emplace_back();
+        job->index.back().read(block.data());
+    }
+    return job->out.write(block.data(), block.size());
+}
+
+bool run_pipe() {
+    PipeJob job;
+    if (!job.in.open(input_file) || !job.out.open(output_file))
+        return false;
+    int nWorkers = std::max(n_thread, 1);
+    char head[ContainerHeader::SIZE];
+    if (compress == 1) {
+        job.header.method = method == 2 ? CODEC_LZ78 : method == 4 ? CODEC_LZW : CODEC_LZ77;
+        job.header.huffman = lz77Options.huffman;
+        job.header.searchBufLen = searchBufLen;
+        job.header.lookAheadBufLen = lookAheadBufLen;
+        job.header.dictSize = dictSize;
+        job.header.blockSize = lz77Options.blockSize > 0 ? lz77Options.blockSize : STREAM_CHUNK_SIZE;
+        if (!job.header.valid()) {
+            printf("Parameters out of range for the container format\n");
+            return false;
+        }
+        job.header.write(head);
+        if (!job.out.write(head, sizeof(head)))
+            return false;
+        // 压缩时使用完整的选项（查找方式等），它们不影响解压
+        job.coders.assign(nWorkers, BlockCoder(job.header.method, searchBufLen, lookAheadBufLen, lz77Options, dictSize));
+    } else {
+        // 先读入各版本共有的部分，版本3起再读入校验和
+        if (job.in.read(head, ContainerHeader::BASE_SIZE) != ContainerHeader::BASE_SIZE)
+            return false;
+        int headLen = (uint8_t)head[4] >= 3 ? ContainerHeader::SIZE : ContainerHeader::BASE_SIZE;
+        if (job.in.read(head + ContainerHeader::BASE_SIZE, headLen - ContainerHeader::BASE_SIZE) != headLen - ContainerHeader::BASE_SIZE
+                || !job.header.read(head, headLen))
+            return false;
+        job.coders.assign(nWorkers, job.header.coder());
+    }
+
+    Pipeline pipeline(nWorkers, nWorkers * 2 + 2); // 每个工作线程之外，读、写两端各有一块缓冲
+    bool ok;
+    if (compress == 1) {
+        ok = pipeline.run(pipe_read_raw, pipe_compress_block, pipe_write, &job);
+        vector<char> index;
+        writeContainerIndex(job.index, index);
+        ok = ok && job.out.write(index.data(), index.size());
+    } else {
+        ok = pipeline.run(pipe_read_frame, pipe_decompress_block, pipe_write, &job);
+    }
+    return job.out.close() && ok;
+}
+
+/*
+ * 并行解压容器：参数取自容器头部，输出长度由索引得到，直接映射输出文件，各块解压到最终位置。
+ * 给出--range时只输出原始数据中的一段。
+ */
+bool decompress_container(const char *inBuffer, size_t inSize, OutputFile &outFile) {
+    ContainerReader reader;
+    if (!reader.open(inBuffer, inSize))
+        return false;
+    if (range_begin >= 0) { // 只解压与这一段重叠的块
+        size_t begin = std::min((size_t)range_begin, reader.rawSize());
+        vector<char> out(std::min((size_t)range_len, reader.rawSize() - begin));
+        return reader.decompressRange(n_thread, begin, out.size(), out.data()) >= 0 && outFile.write(out.data(), out.size());
+    }
+    size_t total = reader.rawSize();
+    char *out = total ? outFile.map(total) : NULL;
+    return (total == 0 || out) && reader.decompress(n_thread, out, total) >= 0;
+}
+
+void io_error() {
+    printf("I/O error\n");
+    exit(-1);
+}
+
+/*
+ * 程序退出时以JSON向stderr输出计数器，stdout上的提示信息不受影响。
+ */
+void print_stats() {
+#ifdef LZ_STATS
+    lzStatsPrint(stderr);
+#else
+    fprintf(stderr, "stats not compiled in, rebuild with make DEFS=-DLZ_STATS\n");
+#endif
+}
+
 int main(int argc, char *argv[]) {
     // 解析参数
     parse_arg(argc, argv);
+    if (show_stats)
+        atexit(print_stats);
 
-    ifstream inFile(input_file, ifstream::in | ifstream::binary);
-    streampos begin = inFile.tellg(), end;
-    inFile.seekg(0, ios::end);
-    end = inFile.tellg();
-    int inSize = end - begin; // 获取文件大小
-    inFile.seekg(0, ios::beg);
+    if (pipe_mode && range_begin < 0) { // 随机访问需要映射整个输入，--range总是走下面的容器解压
+        printf(compress == 1 ? "Compress + pipeline\n" : "Decompress + pipeline\n");
+        if (!run_pipe())
+            io_error();
+        return 0;
+    }
 
-    char *inBuffer = new char[inSize];
-    inFile.read(inBuffer, inSize);
-    inFile.close();
+    // 输入文件映射到内存，各算法直接在映射区上工作
+    MappedFile inFile;
+    OutputFile outFile;
+    if (!inFile.open(input_file) || !outFile.open(output_file))
+        io_error();
+    const char *inBuffer = inFile.data();
+    size_t inSize = inFile.size();
 
-    // 执行{compress, decompress} x {LZ77, LZ78}中的一种
+    bool ok = true;
+    if (compress == 2 && isContainer(inBuffer, inSize)) { // 容器格式自带参数，不论指定了哪种算法
+        printf("Decompress + container\n");
+        if (!decompress_container(inBuffer, inSize, outFile) | !outFile.close())
+            io_error();
+        return 0;
+    }
+
+    if (range_begin >= 0) {
+        printf("--range requires a container (compressed with --pipe)\n");
+        exit(-1);
+    }
+
+    if (dict_file) {
+        if (method == 3 || long_window > 0) {
+            printf("--dict cannot be used with -p or --long\n");
+            exit(-1);
+        }
+        printf(compress == 1 ? "Compress + dictionary\n" : "Decompress + dictionary\n");
+        if (!code_with_dictionary(inBuffer, inSize, outFile) | !outFile.close())
+            io_error();
+        return 0;
+    }
+
+    // 执行{compress, decompress} x {LZ77, LZ78, LZ77 parallel, LZW}中的一种
     if (compress == 1) { // 压缩
-      vector<char> src(inBuffer, inBuffer + inSize);
-      if (method == 1) { // LZ77
-        printf("Compress + LZ77\n");
-        vector<Lz77OutputUnit> dst;
-        int outLen = compressLz77(src, dst, searchBufLen, lookAheadBufLen);
-        char *outBuffer = new char[sizeof(Lz77OutputUnit) * outLen];
-        int len = 0;
-        for (auto u : dst)
-          len += u.write(outBuffer + len);
-        ofstream outFile(output_file, ofstream::out | ofstream::binary);
-        outFile.write(outBuffer, len);
-        outFile.close();
-        delete[] outBuffer;
+        if (method == 1 && long_window > 0) { // LZ77 + 长距离匹配，需要整个输入
+            printf("Compress + LZ77 long distance\n");
+            LdmOptions ldm;
+            ldm.window = std::min(long_window, 2047) << 20;
+            Lz77LongResult dst;
+            ok = inSize <= INT32_MAX;
+            if (ok) {
+                compressLz77Long(inBuffer, inSize, dst, searchBufLen, lookAheadBufLen, lz77Options, ldm);
+                ok = write_long(outFile, dst);
+            }
+        } else if (method == 1) { // LZ77
+            printf("Compress + LZ77\n");
+            ok = stream_compressLz77(inFile, outFile);
         } else if (method == 2) { // LZ78
             printf("Compress + LZ78\n");
-            vector<Lz78OutputUnit> dst;
-            int outLen = compressLz78(src, dst, dictSize);
-            char *outBuffer = new char[sizeof(Lz78OutputUnit) * outLen];
-            int len = 0;
-            for (auto u : dst)
-                len += u.write(outBuffer + len);
-            ofstream outFile(output_file, ofstream::out | ofstream::binary);
-            outFile.write(outBuffer, len);
-            outFile.close();
-            delete[] outBuffer;
+            if (n_thread > 1) { // 多线程时分块，各块使用独立的字典
+                LzBlockResult dst;
+                parallel_compressLz78(n_thread, inBuffer, inSize, dst, dictSize, lz77Options.blockSize);
+                ok = write_lz_blocks(outFile, dst);
+            } else {
+                vector<Lz78OutputUnit> dst;
+                vector<char> packed;
+                compressLz78(inBuffer, inSize, dst, dictSize);
+                packLz78(dst.data(), dst.size(), dictSize, packed);
+                ok = outFile.write(packed.data(), packed.size());
+            }
         } else if (method == 3) { // LZ77 parallel
             printf("Compress + LZ77 parallel\n");
             Lz77ParallelResult dst;
-            int outLen = parallel_compressLz77(n_thread, src, dst, searchBufLen, lookAheadBufLen);
-            char *outBuffer = new char[sizeof(int) + sizeof(int) * n_thread + sizeof(Lz77OutputUnit) * outLen];
-            memcpy(outBuffer, &n_thread, sizeof(n_thread));
-            int len = sizeof(n_thread);
-            for (int u : dst.lens) {
-                memcpy(outBuffer + len, &u, sizeof(u));
-                len += sizeof(u);
+            parallel_compressLz77(n_thread, inBuffer, inSize, dst, searchBufLen, lookAheadBufLen, lz77Options);
+            // [块数][窗口][各块解压后的长度][各块三元组个数]，Huffman编码时最后一项为各块字节数
+            vector<int> header;
+            header.push_back(dst.lens.size());
+            header.push_back(dst.window);
+            header.insert(header.end(), dst.rawLens.begin(), dst.rawLens.end());
+            if (lz77Options.huffman) {
+                for (auto &v : dst.coded)
+                    header.push_back(v.size());
+                ok = outFile.write(header.data(), sizeof(int) * header.size());
+                for (auto &v : dst.coded)
+                    ok = ok && outFile.write(v.data(), v.size());
+            } else {
+                header.insert(header.end(), dst.lens.begin(), dst.lens.end());
+                ok = write_units(outFile, (const char *)header.data(), sizeof(int) * header.size(), dst.blocks);
             }
-            for (auto v : dst.blocks)
-                for (Lz77OutputUnit u : v)
-                    len += u.write(outBuffer + len);
-            ofstream outFile(output_file, ofstream::out | ofstream::binary);
-            outFile.write(outBuffer, len);
-            outFile.close();
-            delete[] outBuffer;
         } else if (method == 4) { // LZW
             printf("Compress + LZW\n");
-            vector<LzWOutputUnit> dst;
-            int outLen = compressLzW(src, dst, dictSize);
-            char *outBuffer = new char[sizeof(LzWOutputUnit) * outLen];
-            int len = 0;
-            for (auto u : dst)
-                len += u.write(outBuffer + len);
-            ofstream outFile(output_file, ofstream::out | ofstream::binary);
-            outFile.write(outBuffer, len);
-            outFile.close();
-            delete[] outBuffer;
+            if (n_thread > 1) {
+                LzBlockResult dst;
+                parallel_compressLzW(n_thread, inBuffer, inSize, dst, dictSize, lz77Options.blockSize);
+                ok = write_lz_blocks(outFile, dst);
+            } else {
+                vector<LzWOutputUnit> dst;
+                vector<char> packed;
+                compressLzW(inBuffer, inSize, dst, dictSize);
+                packLzW(dst.data(), dst.size(), dictSize, packed);
+                ok = outFile.write(packed.data(), packed.size());
+            }
         }
     } else if (compress == 2) { // 解压
-        if (method == 1) { // LZ77
+        vector<char> dst;
+        if (method == 1 && long_window > 0) { // LZ77 + 长距离匹配
+            printf("Decompress + LZ77 long distance\n");
+            Lz77LongResult src;
+            ok = read_long(inBuffer, inSize, src);
+            int total = ok ? decompressedSizeLz77Long(src) : -1;
+            char *out = total > 0 ? outFile.map(total) : NULL;
+            ok = total == 0 || (out && decompressLz77Long(src, out, total) == total);
+        } else if (method == 1) { // LZ77
             printf("Decompress + LZ77\n");
-            vector<Lz77OutputUnit> src;
-            int pos = 0;
-            while (pos < inSize) {
-                Lz77OutputUnit tmp;
-                pos += tmp.read(inBuffer + pos);
-                src.push_back(tmp);
-            }
-            vector<char> dst;
-            decompressLz77(src, dst, searchBufLen, lookAheadBufLen);
-            ofstream outFile(output_file, ofstream::out | ofstream::binary);
-            outFile.write(dst.data(), dst.size());
-            outFile.close();
+            ok = stream_decompressLz77(inFile, outFile);
         } else if (method == 2) { // LZ78
             printf("Decompress + LZ78\n");
-            vector<Lz78OutputUnit> src;
-            int pos = 0;
-            while (pos < inSize) {
-                Lz78OutputUnit tmp(0, 0);
-                pos += tmp.read(inBuffer + pos);
-                src.push_back(tmp);
+            if (is_lz_blocks(inBuffer, inSize)) {
+                ok = decompress_lz_blocks(inBuffer, inSize, outFile, parallel_decompressLz78);
+            } else {
+                vector<Lz78OutputUnit> src;
+                ok = unpackLz78(inBuffer, inSize, dictSize, src) >= 0;
+                if (ok && n_thread > 1) // 未分块的流也可以按短语长度的前缀和并行展开
+                    ok = parallel_decompressLz78Stream(n_thread, src.data(), src.size(), dst, dictSize) >= 0;
+                else if (ok)
+                    ok = decompressLz78(src, dst, dictSize) >= 0;
             }
-            vector<char> dst;
-            decompressLz78(src, dst, dictSize);
-            ofstream outFile(output_file, ofstream::out | ofstream::binary);
-            outFile.write(dst.data(), dst.size());
-            outFile.close();
         } else if (method == 3) { // LZ77 parallel
             printf("Decompress + LZ77 parallel\n");
             Lz77ParallelResult src;
-            int pos = 0;
-            int srcLen = 0; // LZ77ParallenResult中lens的元素数
-            memcpy(&srcLen, inBuffer, sizeof(srcLen));
-            pos += sizeof(srcLen);
-            for (int i = 0; i < srcLen; i++) {
-                int tmp;
-                memcpy(&tmp, inBuffer + pos, sizeof(tmp));
-                src.lens.push_back(tmp);
-                pos += sizeof(tmp);
-            }
-            for (int i = 0; i < srcLen; i++) {
-                src.blocks.push_back(vector<Lz77OutputUnit>());
-                for (int j = 0; j < src.lens[i]; j++) {
-                    Lz77OutputUnit tmp;
-                    pos += tmp.read(inBuffer + pos);
-                    src.blocks[i].push_back(tmp);
-                }
+            ok = read_parallel_header(inBuffer, inSize, src);
+            if (ok) {
+                // 输出长度已知，直接映射输出文件，各块解压到最终位置
+                size_t total = 0;
+                for (int len : src.rawLens)
+                    total += len;
+                char *out = total ? outFile.map(total) : NULL;
+                ok = (total == 0 || out) && parallel_decompressLz77(n_thread, src, out, total) >= 0;
             }
-            vector<char> dst;
-            parallel_decompressLz77(src, dst, searchBufLen, lookAheadBufLen);
-            ofstream outFile(output_file, ofstream::out | ofstream::binary);
-            outFile.write(dst.data(), dst.size());
-            outFile.close();
         } else if (method == 4) { // LZW
             printf("Decompress + LZW\n");
-            vector<LzWOutputUnit> src;
-            int pos = 0;
-            while (pos < inSize) {
-                LzWOutputUnit tmp;
-                pos += tmp.read(inBuffer + pos);
-                src.push_back(tmp);
+            if (is_lz_blocks(inBuffer, inSize)) {
+                ok = decompress_lz_blocks(inBuffer, inSize, outFile, parallel_decompressLzW);
+            } else {
+                vector<LzWOutputUnit> src;
+                ok = unpackLzW(inBuffer, inSize, dictSize, src) >= 0;
+                if (ok)
+                    ok = decompressLzW(src, dst, dictSize) >= 0;
             }
-            vector<char> dst;
-            decompressLzW(src, dst, dictSize);
-            ofstream outFile(output_file, ofstream::out | ofstream::binary);
-            outFile.write(dst.data(), dst.size());
-            outFile.close();
         }
+        ok = ok && outFile.write(dst.data(), dst.size());
     }
 
-    delete[] inBuffer;
+    if (!outFile.close() || !ok)
+        io_error();
 
     return 0;
 }
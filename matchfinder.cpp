@@ -0,0 +1,371 @@
+#include <algorithm>
+#include <cstdint>
+
+#include "matchfinder.h"
+#include "matchlen.h"
+#include "stats.h"
+
+#define HASH_BITS 15
+
+typedef unsigned char sym_t;
+
+static inline int hash2(const char *p) {
+    return (sym_t)p[0] | ((sym_t)p[1] << 8);
+}
+
+static inline int hash3(const char *p) {
+    unsigned int v = (sym_t)p[0] | ((sym_t)p[1] << 8) | ((sym_t)p[2] << 16);
+    return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+int matchWindowSize(int searchBufLen) {
+    int windowSize = 1;
+    while (windowSize <= searchBufLen)
+        windowSize <<= 1;
+    return windowSize;
+}
+
+/*
+ * 数据向前移动delta个位置后，更新索引中记录的位置，移出缓冲区的位置记为空指针。
+ */
+static void rebase(std::vector<int> &positions, int delta) {
+    for (int &p : positions)
+        p = p >= delta ? p - delta : -1;
+}
+
+/*
+ * 索引中保存的是位置加上base的值。重新reset时若索引大小不变，只需把base增加到上次插入的所有位置之后，
+ * 旧的记录减去新的base后都是负数，会被查找时的窗口检查排除，因此不必清空索引。
+ * base取窗口大小的整数倍，按位置对窗口大小取模寻址的数组不受影响。
+ *
+ * Returns:
+ *     返回新的base。base与新数据的位置之和可能溢出时返回-1，调用者须清空索引并将base置0。
+ */
+static int nextBase(int base, int inserted, int end, int windowSize) {
+    long long next = base + ((long long)inserted + windowSize - 1) / windowSize * windowSize;
+    return next + end <= INT32_MAX ? next : -1;
+}
+
+void BruteForceMatchFinder::reset(const char *buf, int begin, int end, int searchBufLen) {
+    this->buf = buf;
+    this->begin = begin;
+    this->end = end;
+    this->searchBufLen = searchBufLen;
+}
+
+int BruteForceMatchFinder::find(int pos, int maxLen, int &offset) {
+    int bestOffset = -1; // 已找到的最长匹配的偏移量
+    int bestMatchLen = 0; // 已找到的最长匹配的长度
+    for (int i = std::min(pos - begin, searchBufLen); i >= 1; i--) { // 从左至右遍历search buffer，以每个字符为首字符尝试匹配。
+                                                      // 此处i相当于offset，因此是从searchBufLen减小到1。
+        int len = matchLength(buf + pos - i, buf + pos, maxLen);
+        if (len > bestMatchLen) {
+            bestOffset = i;
+            bestMatchLen = len;
+        }
+    }
+    STAT_ADD(lz77_candidates, std::max(0, std::min(pos - begin, searchBufLen)));
+    if (bestMatchLen == 0) // search buffer中没有可匹配的串。
+        bestOffset = 0;
+    offset = bestOffset;
+    return bestMatchLen;
+}
+
+void BruteForceMatchFinder::slide(int delta) {
+    begin = std::max(0, begin - delta);
+    end -= delta;
+}
+
+void HashChainMatchFinder::reset(const char *buf, int begin, int end, int searchBufLen, int chainDepth, int niceLen) {
+    this->buf = buf;
+    this->begin = begin;
+    this->end = end;
+    this->searchBufLen = searchBufLen;
+    this->chainDepth = chainDepth;
+    this->niceLen = niceLen > 0 ? niceLen : INT32_MAX;
+    dict = nullptr;
+    int windowSize = matchWindowSize(searchBufLen);
+    windowMask = windowSize - 1;
+
+    if (prev.size() == (size_t)windowSize && (base = nextBase(base, nextInsert, end, windowSize)) >= 0) {
+        nextInsert = begin;
+        return;
+    }
+    nextInsert = begin;
+    base = 0;
+    head.assign(1 << HASH_BITS, -1); // -1表示空指针
+    prev.assign(windowSize, -1);
+    last1.assign(1 << 8, -1);
+    last2.assign(1 << 16, -1);
+}
+
+void HashChainMatchFinder::insert(int p) {
+    last1[(sym_t)buf[p]] = p + base;
+    if (p + 1 < end)
+        last2[hash2(buf + p)] = p + base;
+    if (p + 2 < end) {
+        int h = hash3(buf + p);
+        prev[p & windowMask] = head[h];
+        head[h] = p + base;
+    }
+}
+
+void HashChainMatchFinder::slide(int delta) {
+    begin = std::max(0, begin - delta);
+    end -= delta;
+    nextInsert -= delta;
+    rebase(head, delta + base);
+    rebase(prev, delta + base);
+    rebase(last1, delta + base);
+    rebase(last2, delta + base);
+    base = 0;
+}
+
+void HashChainMatchFinder::indexAll() {
+    for (; nextInsert < end; nextInsert++)
+        insert(nextInsert);
+}
+
+/*
+ * 沿index（自身或预置字典）中哈希值为h的链查找不早于minPos的候选位置，找到更长的匹配时更新bestLen与bestPos。
+ * 候选位置的数据都在buf中，与index建立索引时的数据相同。
+ */
+inline void HashChainMatchFinder::searchChain(const HashChainMatchFinder &index, int h, int minPos, const char *cur, int maxLen, int &bestLen, int &bestPos) {
+    int cand = index.head[h] - index.base;
+    int depth = chainDepth;
+    for (; cand >= minPos && depth > 0; depth--) {
+        // 先比较当前最长匹配之后的一个符号，不可能更长的候选位置直接跳过
+        if (buf[cand + bestLen] == cur[bestLen]) {
+            int len = matchLength(buf + cand, cur, maxLen);
+            if (len > bestLen) {
+                bestLen = len;
+                bestPos = cand;
+                if (len == maxLen || len >= niceLen)
+                    break;
+            }
+        }
+        cand = index.prev[cand & index.windowMask] - index.base;
+    }
+    STAT_ADD(lz77_candidates, chainDepth - depth);
+}
+
+int HashChainMatchFinder::find(int pos, int maxLen, int &offset) {
+    for (; nextInsert < pos; nextInsert++)
+        insert(nextInsert);
+
+    int minPos = std::max(begin, pos - searchBufLen); // 窗口内最左的可引用位置
+    int dictMinPos = std::max(0, pos - searchBufLen); // 预置字典中最左的可引用位置
+    const char *cur = buf + pos;
+    int bestLen = 0;
+    int bestPos = -1;
+
+    // 沿哈希链查找长度不小于3的匹配，自身的链上没有足够长的匹配时再查预置字典
+    if (maxLen >= 3 && pos + 2 < end) {
+        int h = hash3(cur);
+        searchChain(*this, h, minPos, cur, maxLen, bestLen, bestPos);
+        if (dict && bestLen < maxLen && bestLen < niceLen && dictMinPos < begin)
+            searchChain(*dict, h, dictMinPos, cur, maxLen, bestLen, bestPos);
+    }
+
+    // 哈希链上没有找到时，退而查找长度为2或1的匹配
+    if (bestLen < 2 && maxLen >= 2 && pos + 1 < end) {
+        int cand = last2[hash2(cur)] - base;
+        if (cand < minPos) // 预置字典中的位置都在begin之前
+            cand = dict ? dict->last2[hash2(cur)] - dict->base : -1;
+        if (cand >= dictMinPos) {
+            bestLen = matchLength(buf + cand, cur, maxLen);
+            bestPos = cand;
+        }
+    }
+    if (bestLen < 1 && maxLen >= 1) {
+        int cand = last1[(sym_t)cur[0]] - base;
+        if (cand < minPos) // 预置字典中的位置都在begin之前
+            cand = dict ? dict->last1[(sym_t)cur[0]] - dict->base : -1;
+        if (cand >= dictMinPos) {
+            bestLen = matchLength(buf + cand, cur, maxLen);
+            bestPos = cand;
+        }
+    }
+
+    offset = bestLen ? pos - bestPos : 0;
+    return bestLen;
+}
+
+void BinaryTreeMatchFinder::reset(const char *buf, int begin, int end, int searchBufLen, int lookAheadBufLen, int niceLen) {
+    this->buf = buf;
+    this->begin = begin;
+    this->end = end;
+    this->searchBufLen = searchBufLen;
+    this->lookAheadBufLen = lookAheadBufLen;
+    treeLen = niceLen > 0 ? std::min(niceLen, lookAheadBufLen) : lookAheadBufLen;
+    int windowSize = matchWindowSize(searchBufLen);
+    windowMask = windowSize - 1;
+
+    if (son.size() == (size_t)windowSize * 2 && (base = nextBase(base, nextInsert, end, windowSize)) >= 0) {
+        nextInsert = begin;
+        return;
+    }
+    nextInsert = begin;
+    base = 0;
+    root.assign(1 << 16, -1); // -1表示空指针
+    son.assign(windowSize * 2, -1);
+    last1.assign(1 << 8, -1);
+}
+
+/*
+ * 将位置p插入树中，同时返回查找路径上的最长匹配。
+ */
+int BinaryTreeMatchFinder::insert(int p, int &bestPos) {
+    int bestLen = 0;
+    last1[(sym_t)buf[p]] = p + base;
+    if (p + 1 >= end)
+        return bestLen;
+
+    int lenLimit = std::min(treeLen, end - p);
+    int minPos = std::max(begin, p - searchBufLen);
+    const char *cur = buf + p;
+    int h = hash2(cur);
+    int node = root[h] - base;
+    root[h] = p + base;
+
+    // ptr0指向下一个应挂接比cur小的后缀的位置，ptr1指向下一个应挂接比cur大的后缀的位置
+    int *ptr0 = &son[(p & windowMask) * 2];
+    int *ptr1 = &son[(p & windowMask) * 2 + 1];
+    int len0 = 0, len1 = 0; // 左右边界与cur的公共前缀长度，路径上的节点与cur至少有min(len0, len1)个公共符号
+    STAT(uint64_t visited = 0;)
+    while (true) {
+        if (node < minPos) { // 超出search buffer，树中剩余的节点均已过期
+            *ptr0 = *ptr1 = -1;
+            break;
+        }
+        int *pair = &son[(node & windowMask) * 2];
+        const char *pb = buf + node;
+        STAT(visited++;)
+        int len = std::min(len0, len1);
+        len += matchLength(pb + len, cur + len, lenLimit - len);
+        if (len > bestLen) {
+            bestLen = len;
+            bestPos = node;
+        }
+        if (len == lenLimit) { // 与cur完全相同，用cur替换该节点
+            *ptr0 = pair[0];
+            *ptr1 = pair[1];
+            break;
+        }
+        if ((sym_t)pb[len] < (sym_t)cur[len]) {
+            *ptr0 = node + base;
+            ptr0 = &pair[1];
+            node = *ptr0 - base;
+            len0 = len;
+        } else {
+            *ptr1 = node + base;
+            ptr1 = &pair[0];
+            node = *ptr1 - base;
+            len1 = len;
+        }
+    }
+    STAT_ADD(lz77_candidates, visited);
+    return bestLen;
+}
+
+void BinaryTreeMatchFinder::slide(int delta) {
+    begin = std::max(0, begin - delta);
+    end -= delta;
+    nextInsert -= delta;
+    rebase(root, delta + base);
+    rebase(son, delta + base);
+    rebase(last1, delta + base);
+    base = 0;
+}
+
+int BinaryTreeMatchFinder::find(int pos, int maxLen, int &offset) {
+    int bestPos = -1;
+    for (; nextInsert < pos; nextInsert++)
+        insert(nextInsert, bestPos);
+    int cand = last1[(sym_t)buf[pos]] - base; // 插入pos前记下单符号最近出现的位置
+    int bestLen = std::min(insert(pos, bestPos), maxLen);
+    nextInsert = pos + 1;
+    if (bestLen == treeLen && bestLen < maxLen) // 树中只比较了前treeLen个符号
+        bestLen += matchLength(buf + bestPos + bestLen, buf + pos + bestLen, maxLen - bestLen);
+
+    // 树中没有找到时，退而查找长度为1的匹配
+    if (bestLen < 1 && maxLen >= 1) {
+        int minPos = std::max(begin, pos - searchBufLen);
+        if (cand >= minPos) {
+            bestLen = 1;
+            bestPos = cand;
+        }
+    }
+
+    offset = bestLen ? pos - bestPos : 0;
+    return bestLen;
+}
+
+void MatchFinder::reset(int type, const char *buf, int begin, int end, int searchBufLen, int lookAheadBufLen, int chainDepth, int niceLen) {
+    this->type = type;
+    clearCache();
+    if (type == LZ77_MF_HASH_CHAIN)
+        hashChain.reset(buf, begin, end, searchBufLen, chainDepth, niceLen);
+    else if (type == LZ77_MF_BINARY_TREE)
+        binaryTree.reset(buf, begin, end, searchBufLen, lookAheadBufLen, niceLen);
+    else
+        bruteForce.reset(buf, begin, end, searchBufLen);
+}
+
+void MatchFinder::indexAll() {
+    hashChain.indexAll();
+}
+
+void MatchFinder::attach(const MatchFinder &dict) {
+    hashChain.attach(&dict.hashChain);
+}
+
+void MatchFinder::clearCache() {
+    for (CachedMatch &c : cache)
+        c.pos = -1;
+}
+
+int MatchFinder::find(int pos, int maxLen, int &offset) {
+    CachedMatch &c = cache[pos & (CACHE_SIZE - 1)];
+    if (c.pos == pos) {
+        offset = c.offset;
+        return c.len;
+    }
+    int len;
+    if (type == LZ77_MF_HASH_CHAIN)
+        len = hashChain.find(pos, maxLen, offset);
+    else if (type == LZ77_MF_BINARY_TREE)
+        len = binaryTree.find(pos, maxLen, offset);
+    else
+        len = bruteForce.find(pos, maxLen, offset);
+    c = CachedMatch{pos, len, offset};
+    return len;
+}
+
+void MatchFinder::extend(int end) {
+    if (type == LZ77_MF_HASH_CHAIN)
+        hashChain.extend(end);
+    else if (type == LZ77_MF_BINARY_TREE)
+        binaryTree.extend(end);
+    else
+        bruteForce.extend(end);
+}
+
+void MatchFinder::slide(int delta) {
+    // 缓存按位置寻址，平移后重新放置
+    CachedMatch old[CACHE_SIZE];
+    std::copy(cache, cache + CACHE_SIZE, old);
+    clearCache();
+    for (CachedMatch c : old) {
+        if (c.pos >= delta) {
+            c.pos -= delta;
+            cache[c.pos & (CACHE_SIZE - 1)] = c;
+        }
+    }
+    if (type == LZ77_MF_HASH_CHAIN)
+        hashChain.slide(delta);
+    else if (type == LZ77_MF_BINARY_TREE)
+        binaryTree.slide(delta);
+    else
+        bruteForce.slide(delta);
+}
@@ -0,0 +1,206 @@
+#pragma once
+#include <vector>
+
+/*
+ * LZ77匹配查找器。
+ *
+ * 查找器工作在一段连续缓冲区buf上，所有位置均为相对buf的下标。
+ * [begin, end)为可用数据，其中begin之前的数据不会被引用。
+ * 调用者须按位置递增的顺序调用find，查找器在查找前会自动将尚未插入的位置插入索引。
+ * MatchFinder另外缓存最近查找过的位置，惰性匹配向前试探后回到这些位置时直接取缓存的结果。
+ *
+ * niceLen大于0时，找到不短于niceLen的匹配即停止查找（niceLen为0时不限）。
+ */
+
+/*
+ * LZ77匹配查找方式
+ */
+enum Lz77MatchFinder {
+    LZ77_MF_BRUTE,      // 穷举search buffer中的每个偏移量，最慢，但总能找到最长匹配
+    LZ77_MF_HASH_CHAIN, // 哈希链，每次查找的代价由chainDepth决定，与search buffer长度基本无关
+    LZ77_MF_BINARY_TREE, // 二叉树，与穷举一样总能找到最长匹配，代价约为树高而非search buffer长度
+};
+
+/*
+ * 返回不小于searchBufLen + 1的2的幂。查找器的索引按位置对它取模寻址，保证窗口内的位置不会互相覆盖。
+ * 调用slide时，平移量须是它的整数倍。
+ */
+int matchWindowSize(int searchBufLen);
+
+/*
+ * 穷举匹配查找器
+ */
+class BruteForceMatchFinder {
+public:
+    void reset(const char *buf, int begin, int end, int searchBufLen);
+    int find(int pos, int maxLen, int &offset);
+    void extend(int end) { this->end = end; }
+    void slide(int delta);
+
+private:
+    const char *buf;
+    int begin;
+    int end;
+    int searchBufLen;
+};
+
+/*
+ * 哈希链匹配查找器
+ *
+ * 以接下来3个符号的哈希值为键，将search buffer中的位置串成链表，查找时沿链表至多比较chainDepth个候选位置。
+ * 长度为1或2的匹配无法通过3符号哈希找到，因此另外记录每个单符号、双符号最近出现的位置。
+ */
+class HashChainMatchFinder {
+public:
+    /*
+     * 绑定缓冲区并清空索引。再次调用时若searchBufLen不变，则复用已分配的索引，代价与索引大小无关。
+     *
+     * Params:
+     *     buf : 数据缓冲区。
+     *     begin : 可被引用的第一个位置。
+     *     end : 可用数据的结束位置。
+     *     searchBufLen : search buffer的长度，即允许的最大偏移量。
+     *     chainDepth : 每次查找至多比较的候选位置个数。
+     *     niceLen : 找到这么长的匹配即停止沿链查找，0表示不限。
+     */
+    void reset(const char *buf, int begin, int end, int searchBufLen, int chainDepth, int niceLen = 0);
+
+    /*
+     * 查找位置pos处的最长匹配，至多匹配maxLen个符号。
+     *
+     * Returns:
+     *     返回匹配长度，匹配的偏移量写入offset。没有匹配时返回0。
+     */
+    int find(int pos, int maxLen, int &offset);
+
+    /*
+     * 缓冲区末尾追加了数据，可用数据的结束位置变为end。
+     */
+    void extend(int end) { this->end = end; }
+
+    /*
+     * 缓冲区中的数据整体向前移动了delta个位置，delta须是matchWindowSize(searchBufLen)的整数倍。
+     */
+    void slide(int delta);
+
+    /*
+     * 将[begin, end)全部插入索引，用于建立预置字典的索引。
+     */
+    void indexAll();
+
+    /*
+     * 查找时另外沿dict的索引查找[0, begin)中的匹配，自身的索引只包含begin之后的位置。
+     * dict须以相同的searchBufLen建立了完整的索引（见indexAll），且其数据与buf中[0, begin)相同。
+     * dict的索引只读，可以被多个查找器共用，因此每次压缩不必重新索引预置字典。reset后取消，期间不能调用slide。
+     */
+    void attach(const HashChainMatchFinder *dict) { this->dict = dict; }
+
+private:
+    void insert(int p);
+    void searchChain(const HashChainMatchFinder &index, int h, int minPos, const char *cur, int maxLen, int &bestLen, int &bestPos);
+
+    const char *buf;
+    int begin;
+    int end;
+    int searchBufLen;
+    int chainDepth;
+    int niceLen;
+    int nextInsert; // 下一个待插入的位置
+    int base;       // 索引中保存的是位置加上base的值，见reset
+    const HashChainMatchFinder *dict = nullptr; // 预置字典的索引，见attach
+
+    int windowMask;         // prev数组按位置对窗口大小取模寻址
+    std::vector<int> head;  // 3符号哈希 -> 最近出现的位置
+    std::vector<int> prev;  // 位置 -> 同一哈希值的前一个位置
+    std::vector<int> last1; // 单符号 -> 最近出现的位置
+    std::vector<int> last2; // 双符号 -> 最近出现的位置
+};
+
+/*
+ * 二叉树匹配查找器
+ *
+ * 与LZMA的bt查找器类似：以前2个符号为键，每个键下将search buffer中的位置按其后缀的字典序组织成一棵二叉搜索树。
+ * 插入新位置时从根向下查找，最长匹配一定出现在查找路径上，因此总能找到search buffer中的最长匹配。
+ * 每个位置都要插入树中，比哈希链慢，适合追求压缩率的场合。
+ */
+class BinaryTreeMatchFinder {
+public:
+    /*
+     * 绑定缓冲区并清空索引。
+     * 参数意义与HashChainMatchFinder::reset相同，lookAheadBufLen为look ahead buffer的长度，即树中比较的最大长度。
+     * niceLen大于0且小于lookAheadBufLen时，树中只比较前niceLen个符号（与LZMA相同），找到这么长的匹配后直接向后延长。
+     */
+    void reset(const char *buf, int begin, int end, int searchBufLen, int lookAheadBufLen, int niceLen = 0);
+
+    /*
+     * 查找位置pos处的最长匹配，至多匹配maxLen个符号。maxLen不应超过lookAheadBufLen。
+     *
+     * Returns:
+     *     返回匹配长度，匹配的偏移量写入offset。没有匹配时返回0。
+     */
+    int find(int pos, int maxLen, int &offset);
+    void extend(int end) { this->end = end; }
+    void slide(int delta);
+
+private:
+    int insert(int p, int &bestPos);
+
+    const char *buf;
+    int begin;
+    int end;
+    int searchBufLen;
+    int lookAheadBufLen;
+    int treeLen;    // 树中比较的最大长度
+    int nextInsert; // 下一个待插入的位置
+    int base;       // 索引中保存的是位置加上base的值，见HashChainMatchFinder::reset
+
+    int windowMask;         // son数组按位置对窗口大小取模寻址
+    std::vector<int> root;  // 双符号 -> 树根，即最近出现的位置
+    std::vector<int> son;   // 位置 -> 左右子树，son[2 * i]为左子树，son[2 * i + 1]为右子树
+    std::vector<int> last1; // 单符号 -> 最近出现的位置
+};
+
+/*
+ * 按类型选择上述匹配查找器之一，接口与各查找器相同。
+ */
+class MatchFinder {
+public:
+    /*
+     * Params:
+     *     type : 查找方式，取值见Lz77MatchFinder。
+     *     chainDepth : 哈希链查找时每个位置至多比较的候选位置个数。
+     *     niceLen : 见文件开头，穷举查找不受此限制。
+     *     其余参数与各查找器的reset相同。
+     */
+    void reset(int type, const char *buf, int begin, int end, int searchBufLen, int lookAheadBufLen, int chainDepth, int niceLen = 0);
+
+    /*
+     * 同各查找器的find。pos可以是最近CACHE_SIZE个位置以内已查找过的位置，此时返回缓存的结果，maxLen须与当时相同。
+     */
+    int find(int pos, int maxLen, int &offset);
+    void extend(int end);
+    void slide(int delta);
+
+    /*
+     * 同HashChainMatchFinder::indexAll与attach，只用于哈希链查找，dict也须是哈希链查找器。
+     */
+    void indexAll();
+    void attach(const MatchFinder &dict);
+
+    static const int CACHE_SIZE = 16; // 2的幂
+
+private:
+    struct CachedMatch {
+        int pos; // -1表示空
+        int len;
+        int offset;
+    };
+
+    void clearCache();
+
+    int type;
+    CachedMatch cache[CACHE_SIZE]; // 按位置对CACHE_SIZE取模寻址
+    BruteForceMatchFinder bruteForce;
+    HashChainMatchFinder hashChain;
+    BinaryTreeMatchFinder binaryTree;
+};
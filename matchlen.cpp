@@ -0,0 +1,113 @@
+#include "matchlen.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS
+#endif
+
+/*
+ * 逐字节比较剩余不足一个字的尾部。
+ */
+static inline int matchTail(const char *a, const char *b, int i, int maxLen) {
+    for (; i < maxLen; i++) {
+        if (a[i] != b[i])
+            return i;
+    }
+    return maxLen;
+}
+
+/*
+ * 每次比较8字节，找到不相同的字后用异或结果的末尾0个数定位第一个不同的字节。
+ */
+static int matchLengthWord(const char *a, const char *b, int maxLen) {
+    int i = 0;
+    for (; i + 8 <= maxLen; i += 8) {
+        uint64_t x, y;
+        std::memcpy(&x, a + i, 8);
+        std::memcpy(&y, b + i, 8);
+        if (x != y)
+            return i + firstDiffByte(x ^ y);
+    }
+    return matchTail(a, b, i, maxLen);
+}
+
+#ifdef HAVE_X86_KERNELS
+__attribute__((target("sse2")))
+static int matchLengthSse2(const char *a, const char *b, int maxLen) {
+    int i = 0;
+    for (; i + 16 <= maxLen; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+        unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) ^ 0xFFFF; // 不相同的字节对应的位为1
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+    return i + matchLengthWord(a + i, b + i, maxLen - i);
+}
+
+__attribute__((target("avx2")))
+static int matchLengthAvx2(const char *a, const char *b, int maxLen) {
+    int i = 0;
+    for (; i + 32 <= maxLen; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+        unsigned int mask = ~(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y));
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+    return i + matchLengthSse2(a + i, b + i, maxLen - i);
+}
+#endif
+
+static bool cpuSupports(int kernel) {
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init(); // 可能在其他全局构造函数之前被调用
+#endif
+    switch (kernel) {
+    case MATCH_KERNEL_WORD:
+        return true;
+#ifdef HAVE_X86_KERNELS
+    case MATCH_KERNEL_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case MATCH_KERNEL_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+static int currentKernel = MATCH_KERNEL_WORD;
+
+int (*matchLengthWide)(const char *a, const char *b, int maxLen) = matchLengthWord;
+
+bool setMatchLengthKernel(int kernel) {
+    if (!cpuSupports(kernel))
+        return false;
+    switch (kernel) {
+#ifdef HAVE_X86_KERNELS
+    case MATCH_KERNEL_SSE2:
+        matchLengthWide = matchLengthSse2;
+        break;
+    case MATCH_KERNEL_AVX2:
+        matchLengthWide = matchLengthAvx2;
+        break;
+#endif
+    default:
+        matchLengthWide = matchLengthWord;
+        break;
+    }
+    currentKernel = kernel;
+    return true;
+}
+
+int getMatchLengthKernel() {
+    return currentKernel;
+}
+
+/*
+ * 程序启动时选择CPU支持的最快实现。
+ */
+static bool kernelSelected = setMatchLengthKernel(MATCH_KERNEL_AVX2)
+    || setMatchLengthKernel(MATCH_KERNEL_SSE2)
+    || setMatchLengthKernel(MATCH_KERNEL_WORD);
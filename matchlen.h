@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+/*
+ * 匹配长度计算
+ *
+ * 计算符号串a与b的公共前缀长度，是所有匹配查找器最内层的循环。
+ * 前8个符号在此内联地按字比较，更长的部分交给运行时按CPU选择的宽比较实现（AVX2/SSE2/按字比较）。
+ */
+
+enum MatchLengthKernel {
+    MATCH_KERNEL_WORD, // 每次比较8字节，可移植
+    MATCH_KERNEL_SSE2, // 每次比较16字节
+    MATCH_KERNEL_AVX2, // 每次比较32字节
+};
+
+/*
+ * 选择宽比较实现，默认在程序启动时选择CPU支持的最快实现。
+ *
+ * Returns:
+ *     CPU不支持该实现时返回false，此时不做修改。
+ */
+bool setMatchLengthKernel(int kernel);
+
+/*
+ * 返回当前使用的宽比较实现。
+ */
+int getMatchLengthKernel();
+
+extern int (*matchLengthWide)(const char *a, const char *b, int maxLen);
+
+/*
+ * 返回x中最低的非零字节的下标（按内存顺序），x不能为0。
+ */
+static inline int firstDiffByte(uint64_t x) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return __builtin_clzll(x) >> 3;
+#else
+    return __builtin_ctzll(x) >> 3;
+#endif
+}
+
+/*
+ * 尝试匹配符号串a与b，至多匹配maxLen个符号。
+ *
+ * Returns:
+ *     返回成功匹配的长度。
+ */
+static inline int matchLength(const char *a, const char *b, int maxLen) {
+    if (maxLen >= 8) {
+        uint64_t x, y;
+        std::memcpy(&x, a, 8);
+        std::memcpy(&y, b, 8);
+        if (x != y)
+            return firstDiffByte(x ^ y);
+        return 8 + matchLengthWide(a + 8, b + 8, maxLen - 8);
+    }
+    for (int i = 0; i < maxLen; i++) {
+        if (a[i] != b[i])
+            return i;
+    }
+    return maxLen;
+}
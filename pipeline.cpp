@@ -0,0 +1,154 @@
+#include "pipeline.h"
+#include "stats.h"
+
+struct WorkerStart {
+    Pipeline *pipeline;
+    int worker;
+};
+
+Pipeline::Pipeline(int nWorkers, int maxBlocks)
+        : nWorkers(nWorkers > 0 ? nWorkers : 1), maxBlocks(maxBlocks > this->nWorkers ? maxBlocks : this->nWorkers + 1),
+          blocks(this->maxBlocks) {
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&changed, NULL);
+}
+
+Pipeline::~Pipeline() {
+    pthread_mutex_destroy(&lock);
+    pthread_cond_destroy(&changed);
+}
+
+void *Pipeline::readerMain(void *arg) {
+    ((Pipeline *)arg)->readLoop();
+    return NULL;
+}
+
+void *Pipeline::workerMain(void *arg) {
+    WorkerStart start = *(WorkerStart *)arg;
+    delete (WorkerStart *)arg;
+    start.pipeline->workLoop(start.worker);
+    return NULL;
+}
+
+void Pipeline::readLoop() {
+    while (true) {
+        pthread_mutex_lock(&lock);
+        while (!failed && freeBlocks.empty())
+            pthread_cond_wait(&changed, &lock);
+        if (failed) {
+            pthread_mutex_unlock(&lock);
+            return;
+        }
+        Block *block = freeBlocks.back();
+        freeBlocks.pop_back();
+        pthread_mutex_unlock(&lock);
+
+        block->in.clear();
+        STAT(uint64_t t0 = lzStatsNow();)
+        int r = readFn(arg, block->in);
+        STAT_ADD(pipe_read_ns, lzStatsNow() - t0);
+        STAT_ADD(pipe_read_bytes, r > 0 ? block->in.size() : 0);
+
+        pthread_mutex_lock(&lock);
+        if (r > 0) {
+            block->seq = nRead++;
+            pending[(pendingHead + pendingCount++) % maxBlocks] = block;
+        } else {
+            freeBlocks.push_back(block);
+            readerDone = true;
+            failed = failed || r < 0;
+        }
+        pthread_cond_broadcast(&changed);
+        pthread_mutex_unlock(&lock);
+        if (r <= 0)
+            return;
+    }
+}
+
+void Pipeline::workLoop(int worker) {
+    while (true) {
+        pthread_mutex_lock(&lock);
+        while (!failed && pendingCount == 0 && !readerDone)
+            pthread_cond_wait(&changed, &lock);
+        if (failed || pendingCount == 0) {
+            pthread_mutex_unlock(&lock);
+            return;
+        }
+        Block *block = pending[pendingHead];
+        pendingHead = (pendingHead + 1) % maxBlocks;
+        pendingCount--;
+        pthread_mutex_unlock(&lock);
+
+        block->out.clear();
+        STAT(uint64_t t0 = lzStatsNow();)
+        bool ok = workFn(arg, worker, block->in, block->out);
+        STAT_ADD(pipe_work_ns, lzStatsNow() - t0);
+        STAT_ADD(pipe_work_bytes, block->in.size());
+
+        pthread_mutex_lock(&lock);
+        done[block->seq % maxBlocks] = block;
+        failed = failed || !ok;
+        pthread_cond_broadcast(&changed);
+        pthread_mutex_unlock(&lock);
+    }
+}
+
+bool Pipeline::run(ReadFn read, WorkFn work, WriteFn write, void *arg) {
+    readFn = read;
+    workFn = work;
+    writeFn = write;
+    this->arg = arg;
+    freeBlocks.clear();
+    for (Block &block : blocks)
+        freeBlocks.push_back(&block);
+    pending.assign(maxBlocks, NULL);
+    pendingHead = pendingCount = 0;
+    done.assign(maxBlocks, NULL);
+    nRead = 0;
+    readerDone = false;
+    failed = false;
+
+    std::vector<pthread_t> threads;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, readerMain, this))
+        return false;
+    threads.push_back(thread);
+    for (int i = 0; i < nWorkers; i++) {
+        if (pthread_create(&thread, NULL, workerMain, new WorkerStart{this, i}))
+            break; // 创建失败时以已有的工作线程继续
+        threads.push_back(thread);
+    }
+    if (threads.size() == 1) { // 没有工作线程，无法继续
+        pthread_mutex_lock(&lock);
+        failed = true;
+        pthread_cond_broadcast(&changed);
+        pthread_mutex_unlock(&lock);
+    }
+
+    // 按读入的顺序写出
+    for (long long next = 0; ; next++) {
+        pthread_mutex_lock(&lock);
+        while (!failed && !done[next % maxBlocks] && !(readerDone && next == nRead))
+            pthread_cond_wait(&changed, &lock);
+        Block *block = failed ? NULL : done[next % maxBlocks];
+        done[next % maxBlocks] = NULL;
+        pthread_mutex_unlock(&lock);
+        if (!block)
+            break;
+
+        STAT(uint64_t t0 = lzStatsNow();)
+        bool ok = writeFn(arg, block->out);
+        STAT_ADD(pipe_write_ns, lzStatsNow() - t0);
+        STAT_ADD(pipe_write_bytes, block->out.size());
+
+        pthread_mutex_lock(&lock);
+        freeBlocks.push_back(block);
+        failed = failed || !ok;
+        pthread_cond_broadcast(&changed);
+        pthread_mutex_unlock(&lock);
+    }
+
+    for (pthread_t t : threads)
+        pthread_join(t, NULL);
+    return !failed;
+}
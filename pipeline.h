@@ -0,0 +1,82 @@
+#pragma once
+#include <pthread.h>
+#include <vector>
+
+/*
+ * 读入-处理-写出流水线
+ *
+ * 一个读线程逐块读入输入，nWorkers个工作线程各自处理一块，调用run的线程作为写线程，按读入的顺序写出结果。
+ * 各阶段之间以有界队列相连：同时在途的块数不超过maxBlocks，读线程领先过多时等待写线程，
+ * 内存占用与输入长度无关。读、写与计算互相重叠，总时间接近max(I/O, 计算)而非两者之和。
+ * 块的缓冲区在各块之间循环使用，稳态下不分配内存。
+ */
+class Pipeline {
+public:
+    /*
+     * 读入下一块到block（调用前已清空）。
+     *
+     * Returns:
+     *     读到一块时返回1，输入结束时返回0，出错时返回-1。
+     */
+    typedef int (*ReadFn)(void *arg, std::vector<char> &block);
+
+    /*
+     * 处理一块，将结果写入out（调用前已清空）。worker为工作线程编号，取值为0..nWorkers-1，可用于索引线程私有的数据。
+     *
+     * Returns:
+     *     出错时返回false。
+     */
+    typedef bool (*WorkFn)(void *arg, int worker, const std::vector<char> &in, std::vector<char> &out);
+
+    /*
+     * 写出一块的处理结果。
+     *
+     * Returns:
+     *     出错时返回false。
+     */
+    typedef bool (*WriteFn)(void *arg, const std::vector<char> &block);
+
+    Pipeline(int nWorkers, int maxBlocks);
+    ~Pipeline();
+    Pipeline(const Pipeline &) = delete;
+    Pipeline &operator=(const Pipeline &) = delete;
+
+    /*
+     * 运行流水线直到输入结束，arg原样传给三个函数。任一阶段出错时其余阶段尽快停止。
+     *
+     * Returns:
+     *     全部块都成功写出时返回true。
+     */
+    bool run(ReadFn read, WorkFn work, WriteFn write, void *arg);
+
+private:
+    struct Block {
+        long long seq; // 读入的顺序
+        std::vector<char> in, out;
+    };
+
+    static void *readerMain(void *arg);
+    static void *workerMain(void *arg);
+    void readLoop();
+    void workLoop(int worker);
+
+    int nWorkers;
+    int maxBlocks;
+    std::vector<Block> blocks;
+    std::vector<Block *> freeBlocks; // 空闲的块
+    std::vector<Block *> pending;    // 已读入、等待处理的块，长为maxBlocks的环形队列，按读入顺序
+    int pendingHead;                 // pending中下一个待处理的块
+    int pendingCount;                // pending中的块数
+    std::vector<Block *> done;       // 已处理、等待写出的块，第seq块位于done[seq % maxBlocks]
+
+    pthread_mutex_t lock;
+    pthread_cond_t changed; // 任一队列发生变化
+    long long nRead;        // 已读入的块数
+    bool readerDone;        // 输入已结束
+    bool failed;
+
+    ReadFn readFn;
+    WorkFn workFn;
+    WriteFn writeFn;
+    void *arg;
+};
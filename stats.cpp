@@ -0,0 +1,75 @@
+#include <chrono>
+#include <pthread.h>
+#include <vector>
+
+#include "stats.h"
+
+static pthread_mutex_t registryLock = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<LzStats *> registry; // 各线程的计数器，按登记顺序；线程退出后保留，以便汇总
+
+static LzStats *registerThread() {
+    LzStats *stats = new LzStats();
+    pthread_mutex_lock(&registryLock);
+    registry.push_back(stats);
+    pthread_mutex_unlock(&registryLock);
+    return stats;
+}
+
+LzStats &lzStatsLocal() {
+    thread_local LzStats *local = registerThread();
+    return *local;
+}
+
+uint64_t lzStatsNow() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void lzStatsBlock(uint64_t ns, uint64_t bytes) {
+    LzStats &s = lzStatsLocal();
+    s.blocks++;
+    s.block_bytes += bytes;
+    s.block_ns += ns;
+    if (ns > s.block_max_ns)
+        s.block_max_ns = ns;
+}
+
+#define SUM(a, b) ((a) + (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+static void printFields(FILE *f, const LzStats &s) {
+    const char *sep = "";
+#define LZ_STAT_PRINT(name, merge) fprintf(f, "%s\"" #name "\": %llu", sep, (unsigned long long)s.name); sep = ", ";
+    LZ_STAT_FIELDS(LZ_STAT_PRINT)
+#undef LZ_STAT_PRINT
+}
+
+static double ratio(uint64_t a, uint64_t b) {
+    return b ? (double)a / b : 0;
+}
+
+void lzStatsPrint(FILE *f) {
+    pthread_mutex_lock(&registryLock);
+    LzStats total = LzStats();
+    for (LzStats *s : registry) {
+#define LZ_STAT_MERGE(name, merge) total.name = merge(total.name, s->name);
+        LZ_STAT_FIELDS(LZ_STAT_MERGE)
+#undef LZ_STAT_MERGE
+    }
+
+    fprintf(f, "{\"total\": {");
+    printFields(f, total);
+    fprintf(f, "},\n \"derived\": {\"lz77_candidates_per_position\": %.3f, \"lz77_avg_match\": %.3f, \"lz77_literal_ratio\": %.4f, "
+               "\"block_avg_ns\": %.0f, \"block_mbps\": %.2f, \"pipe_read_mbps\": %.2f, \"pipe_work_mbps\": %.2f, \"pipe_write_mbps\": %.2f},\n",
+            ratio(total.lz77_candidates, total.lz77_positions), ratio(total.lz77_match_bytes, total.lz77_units - total.lz77_literals),
+            ratio(total.lz77_literals, total.lz77_units), ratio(total.block_ns, total.blocks),
+            ratio(total.block_bytes * 1000, total.block_ns), ratio(total.pipe_read_bytes * 1000, total.pipe_read_ns),
+            ratio(total.pipe_work_bytes * 1000, total.pipe_work_ns), ratio(total.pipe_write_bytes * 1000, total.pipe_write_ns));
+    fprintf(f, " \"threads\": [");
+    for (size_t i = 0; i < registry.size(); i++) {
+        fprintf(f, "%s\n  {", i ? "," : "");
+        printFields(f, *registry[i]);
+        fprintf(f, "}");
+    }
+    fprintf(f, "]}\n");
+    pthread_mutex_unlock(&registryLock);
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+
+/*
+ * 热路径计数器
+ *
+ * 编译时定义LZ_STATS（make DEFS=-DLZ_STATS）才启用。未定义时STAT、STAT_ADD等宏展开为空，不产生任何代码，
+ * 因此默认构建没有额外开销。启用后每个线程累加自己的一份计数器，不需要原子操作；
+ * 热循环中先累加到局部变量，循环结束后再一次性加到计数器上。
+ * 计数器在各任务结束后（线程池、流水线已同步）由lzStatsPrint汇总输出。
+ */
+
+/*
+ * 计数器列表：X(名称, 合并方式)，合并方式为SUM（求和）或MAX（取最大值）。
+ */
+#define LZ_STAT_FIELDS(X) \
+    X(lz77_positions, SUM)      /* 编码的输入字节数 */ \
+    X(lz77_units, SUM)          /* 输出的三元组个数 */ \
+    X(lz77_literals, SUM)       /* 匹配长度为0的三元组个数 */ \
+    X(lz77_match_bytes, SUM)    /* 匹配长度之和 */ \
+    X(lz77_match_max, MAX)      /* 最长的匹配 */ \
+    X(lz77_candidates, SUM)     /* 查找匹配时比较过的候选位置个数 */ \
+    X(lz77_decoded_units, SUM) \
+    X(lz77_decoded_bytes, SUM) \
+    X(ldm_fingerprints, SUM)    /* 长距离匹配中采样并查表的位置数 */ \
+    X(ldm_matches, SUM)         /* 长距离匹配个数 */ \
+    X(ldm_match_bytes, SUM)     /* 长距离匹配覆盖的字节数 */ \
+    X(lz78_units, SUM) \
+    X(lz78_lookups, SUM)        /* 字典树查找次数 */ \
+    X(lz78_nodes, SUM)          /* 加入字典树的节点数 */ \
+    X(lz78_decoded_units, SUM) \
+    X(lz78_decoded_bytes, SUM) \
+    X(lzw_units, SUM) \
+    X(lzw_lookups, SUM) \
+    X(lzw_nodes, SUM) \
+    X(lzw_decoded_units, SUM) \
+    X(lzw_decoded_bytes, SUM) \
+    X(trie_fill_max, MAX)       /* 字典树最满时的节点数占字典大小的千分比 */ \
+    X(blocks, SUM)              /* 并行驱动处理的块数 */ \
+    X(block_bytes, SUM)         /* 各块的原始长度之和 */ \
+    X(block_ns, SUM)            /* 各块耗时之和 */ \
+    X(block_max_ns, MAX)        /* 最慢的一块 */ \
+    X(stored_blocks, SUM)       /* 容器中未经压缩、原样存储的块数 */ \
+    X(pipe_read_ns, SUM)        /* 流水线各阶段的耗时与字节数 */ \
+    X(pipe_read_bytes, SUM) \
+    X(pipe_work_ns, SUM) \
+    X(pipe_work_bytes, SUM) \
+    X(pipe_write_ns, SUM) \
+    X(pipe_write_bytes, SUM)
+
+struct LzStats {
+#define LZ_STAT_DECLARE(name, merge) uint64_t name;
+    LZ_STAT_FIELDS(LZ_STAT_DECLARE)
+#undef LZ_STAT_DECLARE
+};
+
+/*
+ * 返回当前线程的计数器，第一次调用时登记该线程。
+ */
+LzStats &lzStatsLocal();
+
+/*
+ * 单调时钟，单位为纳秒。
+ */
+uint64_t lzStatsNow();
+
+/*
+ * 记录并行驱动中的一块：耗时ns，原始长度bytes。
+ */
+void lzStatsBlock(uint64_t ns, uint64_t bytes);
+
+/*
+ * 以JSON输出汇总后的计数器、派生指标（每个位置的候选数、平均匹配长度、未匹配比例）与各线程的计数器。
+ */
+void lzStatsPrint(FILE *f);
+
+#ifdef LZ_STATS
+#define STAT(...) __VA_ARGS__
+#define STAT_ADD(name, n) (lzStatsLocal().name += (n))
+#define STAT_MAX(name, v) do { uint64_t _v = (v); LzStats &_s = lzStatsLocal(); if (_v > _s.name) _s.name = _v; } while (0)
+#else
+#define STAT(...)
+#define STAT_ADD(name, n) ((void)0)
+#define STAT_MAX(name, v) ((void)0)
+#endif
@@ -3,10 +3,24 @@
 #include <ctime>
 #include <cstdlib>
 #include <string>
-
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <new>
+
+#include "codec.h"
+#include "container.h"
+#include "crc32c.h"
+#include "dict.h"
 #include "lz77.h"
 #include "lz78.h"
 #include "lzw.h"
+#include "matchlen.h"
+#include "huffman.h"
+#include "ldm.h"
+#include "pipeline.h"
+#include "stats.h"
+#include "threadpool.h"
 
 #define N_SYMBOLS 256
 
@@ -25,6 +39,26 @@ time_t seed = 0;
 
 #define putline(x) printf("%s\n", x)
 
+/*
+ * 墙钟时间（纳秒）。clock()累加所有线程的CPU时间，用它计时看不出多线程的加速。
+ */
+static inline long long wall_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 统计堆内存分配次数，用于检查编解码上下文在稳态下不分配内存。线程池的工作线程也会分配，因此用原子计数
+static std::atomic<size_t> allocCount(0);
+
+void *operator new(size_t size) {
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
 void show_usage() {
     putline("-n; --iter    number iters. (10)");
     putline("--input       maximum input length. (8000000)");
@@ -65,15 +99,15 @@ int rrand(int _max, int range) {
     return _max - tmp * tmp % range;
 }
 
-bool test_lz77(const vector<char> &src, int searchBufLen, int lookAheadBufLen, time_t &time_cost) {
+bool test_lz77(const vector<char> &src, int searchBufLen, int lookAheadBufLen, long long &time_cost) {
     // 分配空间
     vector<Lz77OutputUnit> dst77;
     vector<char> out;
 
-    time_t start = clock();
+    long long start = wall_ns();
     int retval = compressLz77(src, dst77, searchBufLen, lookAheadBufLen);
     retval = decompressLz77(dst77, out, searchBufLen, lookAheadBufLen);
-    time_cost += clock() - start;
+    time_cost += wall_ns() - start;
 
     bool flag = false;
     if (src.size() != retval) flag = false;
@@ -95,15 +129,161 @@ bool test_lz77(const vector<char> &src, int searchBufLen, int lookAheadBufLen, t
     return true;
 }
 
-bool test_lz77_parallel(int num_t, const vector<char> &src, int searchBufLen, int lookAheadBufLen, time_t &time_cost) {
+/*
+ * 检查CPU支持的每种匹配长度实现是否与逐字节比较的结果相同。
+ */
+bool test_match_length() {
+    char a[300], b[300];
+    int saved = getMatchLengthKernel();
+    bool flag = true;
+    for (int kernel : {MATCH_KERNEL_WORD, MATCH_KERNEL_SSE2, MATCH_KERNEL_AVX2}) {
+        if (!setMatchLengthKernel(kernel)) continue;
+        for (int iter = 0; iter < 1000 && flag; iter++) {
+            int maxLen = rand() % 260;
+            int same = rand() % 270; // 公共前缀长度，可能超过maxLen
+            int offset = rand() % 16; // 测试未对齐的起始地址
+            for (int i = 0; i < maxLen; i++)
+                a[offset + i] = b[i] = rand() % N_SYMBOLS;
+            if (same < maxLen) b[same] = ~a[offset + same];
+            int expected = 0;
+            while (expected < maxLen && a[offset + expected] == b[expected]) expected++;
+            if (matchLength(a + offset, b, maxLen) != expected) {
+                printf("Kernel %d: maxLen = %d, expected %d\n", kernel, maxLen, expected);
+                flag = false;
+            }
+        }
+    }
+    setMatchLengthKernel(saved);
+    return flag;
+}
+
+/*
+ * 使用指定的匹配查找方式压缩并解压，检查结果是否正确。
+ * expectedUnits非负时，还要求输出的三元组个数与之相同：能找到最长匹配的查找方式应与穷举查找输出同样多的三元组。
+ */
+bool test_lz77_match_finder(const vector<char> &src, int searchBufLen, int lookAheadBufLen, const Lz77Options &options, int expectedUnits, long long &time_cost) {
+    vector<Lz77OutputUnit> dst77;
+    vector<char> out;
+
+    long long start = wall_ns();
+    int retval = compressLz77(src, dst77, searchBufLen, lookAheadBufLen, options);
+    time_cost += wall_ns() - start;
+    decompressLz77(dst77, out, searchBufLen, lookAheadBufLen);
+
+    if (out != src || (expectedUnits >= 0 && retval != expectedUnits)) {
+        printf("Expected Units: %d\n", expectedUnits);
+        printf("Output Units: %d\n", retval);
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * 解压到调用者提供的缓冲区：缓冲区恰好够用时应正确解压，不够用或偏移量越界时应返回-1。
+ */
+bool test_lz77_buffer(const vector<char> &src, int searchBufLen, int lookAheadBufLen) {
+    vector<Lz77OutputUnit> dst77;
+    compressLz77(src, dst77, searchBufLen, lookAheadBufLen);
+
+    int outLen = decompressedSizeLz77(dst77.data(), dst77.size());
+    vector<char> out(outLen);
+    if (outLen != src.size() || decompressLz77(dst77.data(), dst77.size(), out.data(), outLen) != outLen || out != src)
+        return false;
+    if (outLen > 0 && decompressLz77(dst77.data(), dst77.size(), out.data(), outLen - 1) != -1)
+        return false;
+
+    Lz77OutputUnit bad = {1, 1, 0}; // 第一个三元组不可能引用之前的数据
+    if (decompressLz77(&bad, 1, out.data(), outLen) != -1)
+        return false;
+
+    return true;
+}
+
+/*
+ * 流式压缩与解压：将输入切成随机长度的片段依次输入，压缩结果应与compressLz77完全相同，解压结果应与输入相同。
+ */
+bool test_lz77_stream(const vector<char> &src, int searchBufLen, int lookAheadBufLen, const Lz77Options &options) {
+    vector<Lz77OutputUnit> expected, dst77;
+    compressLz77(src, expected, searchBufLen, lookAheadBufLen, options);
+
+    Lz77StreamEncoder encoder(searchBufLen, lookAheadBufLen, options);
+    for (int pos = 0; pos < src.size(); ) {
+        int n = std::min((int)src.size() - pos, rand() % (3 * searchBufLen) + 1);
+        encoder.update(src.data() + pos, n, dst77);
+        pos += n;
+    }
+    encoder.finish(dst77);
+    if (dst77.size() != expected.size())
+        return false;
+    for (int i = 0; i < dst77.size(); i++) {
+        if (dst77[i].offset != expected[i].offset || dst77[i].length != expected[i].length || dst77[i].symbol != expected[i].symbol)
+            return false;
+    }
+
+    Lz77StreamDecoder decoder(searchBufLen, lookAheadBufLen);
+    vector<char> out;
+    for (int pos = 0; pos < dst77.size(); ) {
+        int n = std::min((int)dst77.size() - pos, rand() % 1000 + 1);
+        if (decoder.update(dst77.data() + pos, n, out) < 0)
+            return false;
+        pos += n;
+    }
+
+    return out == src;
+}
+
+bool test_huffman_lz77(const vector<char> &src, int searchBufLen, int lookAheadBufLen) {
+    vector<Lz77OutputUnit> dst77, decoded;
+    compressLz77(src, dst77, searchBufLen, lookAheadBufLen);
+    vector<char> coded;
+    huffmanEncodeLz77(dst77.data(), dst77.size(), coded);
+    if (huffmanDecodeLz77(coded.data(), coded.size(), decoded) != dst77.size())
+        return false;
+    for (int i = 0; i < dst77.size(); i++) {
+        // 没有未匹配字符（offset为负）时symbol无意义
+        if (decoded[i].offset != dst77[i].offset || decoded[i].length != dst77[i].length
+                || (dst77[i].offset >= 0 && decoded[i].symbol != dst77[i].symbol))
+            return false;
+    }
+    // 截断的输入应当被识别出来
+    if (coded.size() > 8 && huffmanDecodeLz77(coded.data(), coded.size() - 1, decoded) >= 0)
+        return false;
+
+    // 并行压缩时在各线程中完成Huffman编码
+    Lz77Options options;
+    options.huffman = true;
+    Lz77ParallelResult result;
+    vector<char> out;
+    parallel_compressLz77(3, src, result, searchBufLen, lookAheadBufLen, options);
+    if (parallel_decompressLz77(3, result, out) < 0)
+        return false;
+    return out == src;
+}
+
+bool test_lz77_parallel(int num_t, const vector<char> &src, int searchBufLen, int lookAheadBufLen, int blockSize, bool prime, long long &time_cost) {
     // 分配空间
     Lz77ParallelResult dst77;
     vector<char> out;
-
-    time_t start = clock();
-    int retval = parallel_compressLz77(num_t, src, dst77, searchBufLen, lookAheadBufLen);
-    retval = parallel_decompressLz77(dst77, out, searchBufLen, lookAheadBufLen);
-    time_cost += clock() - start;
+    Lz77Options options;
+    options.blockSize = blockSize;
+    options.primeBlocks = prime;
+
+    long long start = wall_ns();
+    int retval = parallel_compressLz77(num_t, src, dst77, searchBufLen, lookAheadBufLen, options);
+    retval = parallel_decompressLz77(num_t, dst77, out);
+    time_cost += wall_ns() - start;
+
+    // 块的划分与线程数无关，单线程压缩的结果应当完全相同
+    Lz77ParallelResult single;
+    parallel_compressLz77(1, src, single, searchBufLen, lookAheadBufLen, options);
+    if (single.lens != dst77.lens || dst77.lens.size() != (src.size() + blockSize - 1) / blockSize)
+        return false;
+    long long rawLen = 0;
+    for (int len : dst77.rawLens)
+        rawLen += len;
+    if (rawLen != src.size())
+        return false;
 
     bool flag = false;
     if (src.size() != retval) flag = false;
@@ -125,15 +305,47 @@ bool test_lz77_parallel(int num_t, const vector<char> &src, int searchBufLen, in
     return true;
 }
 
-bool test_lz78(const vector<char> &src, int dictSize, time_t &time_cost) {
+struct SharedPoolJob {
+    int num_t;
+    const vector<char> *src;
+    int searchBufLen, lookAheadBufLen;
+    vector<char> out;
+};
+
+static void *run_shared_pool_job(void *arg) {
+    SharedPoolJob *job = (SharedPoolJob *)arg;
+    Lz77Options options;
+    options.blockSize = 1 << 14;
+    Lz77ParallelResult result;
+    parallel_compressLz77(job->num_t, *job->src, result, job->searchBufLen, job->lookAheadBufLen, options);
+    parallel_decompressLz77(job->num_t, result, job->out);
+    return NULL;
+}
+
+bool test_shared_pool(int num_t, const vector<char> &src, int searchBufLen, int lookAheadBufLen) {
+    // 同一线程数得到同一个线程池
+    if (&ThreadPool::shared(num_t) != &ThreadPool::shared(num_t) || ThreadPool::shared(num_t + 1).size() != num_t + 1)
+        return false;
+    // 两个线程以不同线程数同时使用共享线程池，不应互相释放对方正在使用的线程池
+    SharedPoolJob jobs[2] = {{num_t, &src, searchBufLen, lookAheadBufLen, {}},
+                             {num_t + 1, &src, searchBufLen, lookAheadBufLen, {}}};
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, run_shared_pool_job, &jobs[1]))
+        return false;
+    run_shared_pool_job(&jobs[0]);
+    pthread_join(thread, NULL);
+    return jobs[0].out == src && jobs[1].out == src;
+}
+
+bool test_lz78(const vector<char> &src, int dictSize, long long &time_cost) {
     // 分配空间
     vector<Lz78OutputUnit> dst78;
     vector<char> out;
 
-    time_t start = clock();
+    long long start = wall_ns();
     int retval = compressLz78(src, dst78, dictSize);
     retval = decompressLz78(dst78, out, dictSize);
-    time_cost += clock() - start;
+    time_cost += wall_ns() - start;
 
     // 检查
     bool flag = false;
@@ -155,15 +367,15 @@ bool test_lz78(const vector<char> &src, int dictSize, time_t &time_cost) {
     return true;
 }
 
-bool test_lzw(const vector<char> &src, int dictSize, time_t &time_cost) {
+bool test_lzw(const vector<char> &src, int dictSize, long long &time_cost) {
     // 分配空间
     vector<LzWOutputUnit> dstW;
     vector<char> out;
 
-    time_t start = clock();
+    long long start = wall_ns();
     int retval = compressLzW(src, dstW, dictSize);
     retval = decompressLzW(dstW, out, dictSize);
-    time_cost += clock() - start;
+    time_cost += wall_ns() - start;
 
     // 检查
     bool flag = false;
@@ -185,10 +397,439 @@ bool test_lzw(const vector<char> &src, int dictSize, time_t &time_cost) {
     return true;
 }
 
+/*
+ * 按短语表解压的边界情况：KwKwK（下标恰为尚未加入字典的一项）、字典已满，以及越界的下标。
+ */
+bool test_phrase_decode() {
+    vector<char> out;
+    for (const char *text : {"aaaaaaaaaaaaaaaaaaaa", "abababababababababab", "abcabcabcabcabcabcabcaaaa"}) {
+        vector<char> src(text, text + strlen(text));
+        for (int dictSize : {2, 4, 258, 300}) {
+            vector<LzWOutputUnit> unitsW;
+            vector<Lz78OutputUnit> units78;
+            compressLzW(src, unitsW, dictSize);
+            compressLz78(src, units78, dictSize);
+            out.clear();
+            if (decompressLzW(unitsW, out, dictSize) != src.size() || out != src)
+                return false;
+            out.clear();
+            if (decompressLz78(units78, out, dictSize) != src.size() || out != src)
+                return false;
+        }
+    }
+    // 下标越过已有的短语时报错，dst保持不变
+    out.assign(3, 'x');
+    vector<LzWOutputUnit> badW(2);
+    badW[0].index = 'a' + 1;
+    badW[1].index = N_SYMBOLS + 5;
+    vector<Lz78OutputUnit> bad78 = {Lz78OutputUnit(0, 'a'), Lz78OutputUnit(3, 'b')};
+    return decompressLzW(badW, out, 1000) < 0 && decompressLz78(bad78, out, 1000) < 0 && out.size() == 3;
+}
+
+/*
+ * 压缩后按位打包再解包，检查能否还原。
+ */
+template <class Unit>
+bool test_pack(const vector<char> &src, int dictSize,
+               int (*compress)(const vector<char> &, vector<Unit> &, int),
+               int (*decompress)(const vector<Unit> &, vector<char> &, int),
+               int (*pack)(const Unit *, int, int, vector<char> &),
+               int (*unpack)(const char *, size_t, int, vector<Unit> &)) {
+    vector<Unit> units, unpacked, truncated;
+    vector<char> packed, out;
+    compress(src, units, dictSize);
+    pack(units.data(), units.size(), dictSize, packed);
+    if (unpack(packed.data(), packed.size(), dictSize, unpacked) != units.size())
+        return false;
+    // 截断的输入应当被识别出来
+    if (packed.size() > 8 && unpack(packed.data(), packed.size() - 2, dictSize, truncated) >= 0)
+        return false;
+    decompress(unpacked, out, dictSize);
+    return out == src;
+}
+
+/*
+ * 并行解压单个LZ78流，结果应与串行解压相同，越界的下标应当被识别出来。
+ */
+bool test_lz78_parallel_decode(int num_t, const vector<char> &src, int dictSize) {
+    vector<Lz78OutputUnit> units;
+    vector<char> expected, out;
+    compressLz78(src, units, dictSize);
+    decompressLz78(units, expected, dictSize);
+    if (parallel_decompressLz78Stream(num_t, units.data(), units.size(), out, dictSize) != src.size() || out != expected)
+        return false;
+    units.back().index = std::min<int>(units.size(), dictSize);
+    out.clear();
+    return parallel_decompressLz78Stream(num_t, units.data(), units.size(), out, dictSize) < 0 && out.empty();
+}
+
+/*
+ * 分块并行压缩后解压，检查能否还原，并且输出与线程数无关、各块与单独压缩再打包的结果相同。
+ */
+bool test_lz_blocks(int num_t, const vector<char> &src, int dictSize, int blockSize,
+                    int (*compress)(int, const char *, int, LzBlockResult &, int, int),
+                    int (*decompress)(int, const LzBlockResult &, char *, size_t, int)) {
+    LzBlockResult dst, single;
+    int n_block = compress(num_t, src.data(), src.size(), dst, dictSize, blockSize);
+    compress(1, src.data(), src.size(), single, dictSize, blockSize);
+    if (n_block != (src.size() + blockSize - 1) / blockSize || dst.packed != single.packed || dst.rawLens != single.rawLens)
+        return false;
+    vector<char> out(src.size());
+    if (decompress(num_t, dst, out.data(), out.size(), dictSize) != src.size() || out != src)
+        return false;
+    // 块的长度与记录的不符时应当报错，不能写到下一块的位置
+    if (dst.rawLens[0] > 0) {
+        dst.rawLens[0]--;
+        if (decompress(num_t, dst, out.data(), out.size() - 1, dictSize) >= 0)
+            return false;
+        dst.rawLens[0]++;
+    }
+    // 某一块损坏时应当报错
+    dst.packed[n_block - 1].resize(dst.packed[n_block - 1].size() / 2);
+    return decompress(num_t, dst, out.data(), out.size(), dictSize) < 0;
+}
+
+/*
+ * CRC32C应与逐位计算的结果相同，分段计算应与整体计算相同。
+ */
+bool test_crc32c(const vector<char> &src) {
+    uint32_t expected = ~0u;
+    for (char c : src) {
+        expected ^= (unsigned char)c;
+        for (int k = 0; k < 8; k++)
+            expected = expected & 1 ? (expected >> 1) ^ 0x82F63B78 : expected >> 1;
+    }
+    expected = ~expected;
+    size_t half = src.size() / 3;
+    return crc32c(0, "123456789", 9) == 0xE3069283 && crc32c(0, src.data(), src.size()) == expected
+        && crc32c(crc32c(0, src.data(), half), src.data() + half, src.size() - half) == expected;
+}
+
+#ifdef LZ_STATS
+/*
+ * 串行压缩、解压后，当前线程的计数器应与输入一致：每个输入字节恰好被编码、解码一次。
+ */
+bool test_stats(const vector<char> &src, int searchBufLen, int lookAheadBufLen, int dictSize) {
+    LzStats before = lzStatsLocal();
+    vector<Lz77OutputUnit> units;
+    vector<Lz78OutputUnit> units78;
+    vector<char> dst77, dst78;
+    compressLz77(src, units, searchBufLen, lookAheadBufLen);
+    decompressLz77(units, dst77, searchBufLen, lookAheadBufLen);
+    compressLz78(src, units78, dictSize);
+    decompressLz78(units78, dst78, dictSize);
+    const LzStats &after = lzStatsLocal();
+    uint64_t withSymbol = 0;
+    for (const Lz77OutputUnit &u : units)
+        withSymbol += u.offset >= 0;
+    return after.lz77_positions - before.lz77_positions == src.size()
+        && after.lz77_units - before.lz77_units == units.size()
+        && after.lz77_match_bytes - before.lz77_match_bytes + withSymbol == src.size()
+        && after.lz77_decoded_bytes - before.lz77_decoded_bytes == src.size()
+        && after.lz78_lookups - before.lz78_lookups == src.size()
+        && after.lz78_units - before.lz78_units == units78.size()
+        && after.lz78_decoded_bytes - before.lz78_decoded_bytes == src.size()
+        && after.trie_fill_max <= 1000;
+}
+#endif
+
+/*
+ * 分块写成容器后并行解压，结果应与输入相同，任意一段的随机访问解压也应正确；改动任一字节后应当被识别出来。
+ */
+bool test_container(int num_t, const vector<char> &src, int method, int searchBufLen, int lookAheadBufLen, int dictSize, int blockSize) {
+    ContainerHeader header;
+    header.method = method;
+    header.huffman = method == CODEC_LZ77;
+    header.searchBufLen = searchBufLen;
+    header.lookAheadBufLen = lookAheadBufLen;
+    header.dictSize = dictSize;
+    header.blockSize = blockSize;
+    vector<char> file(ContainerHeader::SIZE);
+    header.write(file.data());
+    BlockCoder coder = header.coder();
+    vector<ContainerBlock> blocks;
+    for (size_t pos = 0; pos < src.size(); pos += blockSize)
+        blocks.push_back(encodeContainerFrame(coder, src.data() + pos, std::min(src.size() - pos, (size_t)blockSize), file));
+    writeContainerIndex(blocks, file);
+    for (const ContainerBlock &block : blocks) { // 压缩后变长的块应当改为存储
+        if (block.codedLen > block.rawLen || (block.stored && block.codedLen != block.rawLen))
+            return false;
+    }
+
+    ContainerReader reader;
+    if (!reader.open(file.data(), file.size()) || reader.rawSize() != src.size() || reader.header().dictSize != dictSize)
+        return false;
+    vector<char> out(src.size());
+    if (reader.decompress(num_t, out.data(), out.size()) != src.size() || out != src)
+        return false;
+
+    // 随机取几段，包括跨越块边界与超出末尾的情况，只解压重叠的块
+    for (int k = 0; k < 8; k++) {
+        size_t begin = rand() % (src.size() + 10), len = rand() % (blockSize * 2 + 1);
+        size_t expected = begin < src.size() ? std::min(len, src.size() - begin) : 0;
+        vector<char> part(len);
+        if (reader.decompressRange(num_t, begin, len, part.data()) != expected
+                || !std::equal(part.begin(), part.begin() + expected, src.begin() + std::min(begin, src.size())))
+            return false;
+    }
+
+    // 改动头部的一个字节应被校验和发现；校验和正确但参数超出范围的头部也应被拒绝
+    vector<char> head(file.begin(), file.begin() + ContainerHeader::SIZE);
+    head[4 + rand() % (ContainerHeader::SIZE - 4)] ^= 1 << (rand() % 8);
+    ContainerHeader bad = header;
+    if (bad.read(head.data(), head.size()))
+        return false;
+    bad.dictSize = CONTAINER_MAX_DICT_SIZE + 1;
+    bad.write(head.data());
+    if (bad.read(head.data(), head.size()))
+        return false;
+
+    // 打开时不读帧头，帧头与索引不符时在解压该块时发现
+    vector<char> badFrame(file);
+    badFrame[ContainerHeader::SIZE + rand() % ContainerBlock::SIZE] ^= 1 << (rand() % 8);
+    ContainerReader frameReader;
+    if (!frameReader.open(badFrame.data(), badFrame.size()) || frameReader.decompress(num_t, out.data(), out.size()) >= 0)
+        return false;
+
+    // 改动某块中的一个字节：或者解析失败，或者解压时发现错误
+    file[ContainerHeader::SIZE + ContainerBlock::SIZE + rand() % blocks[0].codedLen] ^= 1 << (rand() % 8);
+    ContainerReader corrupted;
+    return !corrupted.open(file.data(), file.size()) || corrupted.decompress(num_t, out.data(), out.size()) < 0;
+}
+
+/*
+ * 随机字节应被判定为无法压缩，取值范围很小的数据与重复的随机数据则不应；整个容器至多比输入多出帧头与索引。
+ */
+bool test_stored(const vector<char> &random, const vector<char> &low) {
+    vector<char> repeated(random.begin(), random.begin() + std::min(random.size(), (size_t)1000));
+    while (repeated.size() < random.size())
+        repeated.insert(repeated.end(), repeated.begin(), repeated.begin() + std::min(repeated.size(), random.size() - repeated.size()));
+    if (!looksIncompressible(random.data(), random.size()) || looksIncompressible(low.data(), low.size())
+            || looksIncompressible(repeated.data(), repeated.size()))
+        return false;
+
+    ContainerHeader header;
+    header.method = CODEC_LZW;
+    header.dictSize = 4096;
+    header.blockSize = 1 << 16;
+    BlockCoder coder = header.coder();
+    vector<char> file;
+    vector<ContainerBlock> blocks;
+    for (size_t pos = 0; pos < random.size(); pos += header.blockSize)
+        blocks.push_back(encodeContainerFrame(coder, random.data() + pos, std::min(random.size() - pos, (size_t)header.blockSize), file));
+    writeContainerIndex(blocks, file);
+    return file.size() <= random.size() + ContainerBlock::SIZE * (2 * blocks.size() + 2);
+}
+
+/*
+ * 长距离匹配：同一段随机数据相隔超过search buffer重复出现，以及周期远小于长度的重叠重复，都应输出长匹配并正确解压。
+ */
+bool test_long(const vector<char> &random, const vector<char> &low, int searchBufLen, int lookAheadBufLen) {
+    vector<char> piece(random.begin(), random.begin() + std::min(random.size(), (size_t)50000));
+    vector<char> src(piece);
+    src.insert(src.end(), low.begin(), low.end());
+    src.insert(src.end(), piece.begin(), piece.end());
+    for (int i = 0; i < 100000; i++)
+        src.push_back(piece[i % 20]);
+    src.insert(src.end(), low.begin(), low.begin() + low.size() / 2);
+
+    LdmOptions ldm;
+    ldm.rateLog = rand() % 6;
+    Lz77LongResult res;
+    compressLz77Long(src.data(), src.size(), res, searchBufLen, lookAheadBufLen, Lz77Options(), ldm);
+    bool far = false;
+    for (const Lz77LongUnit &m : res.matches)
+        far = far || (m.offset > searchBufLen && m.length >= (int)piece.size() / 2);
+    if (piece.size() == 50000 && (int)low.size() > searchBufLen && !far)
+        return false;
+    int len = decompressedSizeLz77Long(res);
+    vector<char> out(std::max(len, 1));
+    if (len != (int)src.size() || decompressLz77Long(res, out.data(), len) != len || memcmp(out.data(), src.data(), len))
+        return false;
+    if (res.matches.empty())
+        return true;
+    res.matches[0].offset = INT32_MAX; // 偏移量超出已解压的数据
+    return decompressLz77Long(res, out.data(), len) == -1;
+}
+
+/*
+ * 生成一条字段固定、取值随机的短消息，类似JSON日志。
+ */
+vector<char> gen_message() {
+    static const char *keys[] = {"timestamp", "event_type", "user_id", "session", "status", "latency_ms", "path"};
+    string msg = "{";
+    for (const char *key : keys) {
+        if (rand() % 4 == 0)
+            continue;
+        msg += string("\"") + key + "\": \"";
+        for (int n = rand() % 12 + 1; n > 0; n--)
+            msg += (char)('a' + rand() % 26);
+        msg += "\", ";
+    }
+    msg += "}";
+    return vector<char>(msg.begin(), msg.end());
+}
+
+/*
+ * 预置字典：由样本训练字典后，三种算法的短消息压缩结果都应更短且能正确解压。
+ * 同一个编解码器连续处理多条消息，每条的输出都应与新建的编解码器相同，即每次都从字典的快照开始。
+ */
+bool test_dictionary(int searchBufLen, int lookAheadBufLen, int dictSize) {
+    vector<vector<char>> samples;
+    for (int i = 0; i < 200; i++)
+        samples.push_back(gen_message());
+    vector<char> dict;
+    if (trainDictionary(samples, rand() % 4096 + 1024, dict, rand() % 64 + 16) <= 0)
+        return false;
+
+    Lz77Options options;
+    options.matchFinder = rand() % 3;
+    for (int method : {CODEC_LZ77, CODEC_LZ78, CODEC_LZW}) {
+        BlockCoder plain(method, searchBufLen, lookAheadBufLen, options, dictSize);
+        BlockCoder coder(method, searchBufLen, lookAheadBufLen, options, dictSize);
+        coder.setDictionary(dict.data(), dict.size());
+        size_t plainLen = 0, dictLen = 0;
+        for (int i = 0; i < 20; i++) {
+            vector<char> msg = gen_message(), coded, fresh, out;
+            plainLen += plain.compress(msg.data(), msg.size(), coded);
+            coded.clear();
+            dictLen += coder.compress(msg.data(), msg.size(), coded);
+            BlockCoder once(method, searchBufLen, lookAheadBufLen, options, dictSize);
+            once.setDictionary(dict.data(), dict.size());
+            once.compress(msg.data(), msg.size(), fresh);
+            if (fresh != coded || coder.decompress(coded.data(), coded.size(), out) != (int)msg.size() || out != msg)
+                return false;
+        }
+        if (dictLen >= plainLen)
+            return false;
+    }
+    return true;
+}
+
+struct PipelineTest {
+    const vector<char> *src;
+    size_t pos;
+    int blockSize;
+    vector<BlockCoder> coders;
+    vector<char> out;
+};
+
+int pipeline_test_read(void *arg, vector<char> &block) {
+    PipelineTest *t = (PipelineTest *)arg;
+    if (t->pos == t->src->size())
+        return 0;
+    size_t n = std::min(t->src->size() - t->pos, (size_t)t->blockSize);
+    block.assign(t->src->begin() + t->pos, t->src->begin() + t->pos + n);
+    t->pos += n;
+    return 1;
+}
+
+bool pipeline_test_work(void *arg, int worker, const vector<char> &in, vector<char> &out) {
+    PipelineTest *t = (PipelineTest *)arg;
+    vector<char> coded;
+    t->coders[worker].compress(in.data(), in.size(), coded);
+    return t->coders[worker].decompress(coded.data(), coded.size(), out) == in.size();
+}
+
+bool pipeline_test_write(void *arg, const vector<char> &block) {
+    PipelineTest *t = (PipelineTest *)arg;
+    t->out.insert(t->out.end(), block.begin(), block.end());
+    return true;
+}
+
+/*
+ * 流水线逐块压缩再解压，按顺序写出的结果应当与输入相同。
+ */
+bool test_pipeline(int num_t, const vector<char> &src, int method, int searchBufLen, int lookAheadBufLen, int dictSize, int blockSize) {
+    Lz77Options options;
+    options.huffman = method == CODEC_LZ77;
+    PipelineTest t = {&src, 0, blockSize};
+    t.coders.assign(num_t, BlockCoder(method, searchBufLen, lookAheadBufLen, options, dictSize));
+    Pipeline pipeline(num_t, num_t + 1);
+    return pipeline.run(pipeline_test_read, pipeline_test_work, pipeline_test_write, &t) && t.out == src;
+}
+
+/*
+ * 用同一个上下文反复压缩、解压许多段短数据，结果应与每段单独压缩相同，且预热之后不再分配内存。
+ */
+bool test_context(const vector<char> &src, int searchBufLen, int lookAheadBufLen, int dictSize) {
+    const int N_MESSAGES = 200;
+    vector<int> offsets, lens;
+    for (int i = 0; i < N_MESSAGES; i++) {
+        int len = std::min((int)src.size(), rand() % 2000);
+        lens.push_back(len);
+        offsets.push_back(rand() % (src.size() - len + 1));
+    }
+
+    Lz77Options tree;
+    tree.matchFinder = LZ77_MF_BINARY_TREE;
+    Lz77Context chain77(searchBufLen, lookAheadBufLen), tree77(searchBufLen, lookAheadBufLen, tree);
+    Lz78Context ctx78(dictSize);
+    LzWContext ctxW(dictSize);
+    vector<Lz77OutputUnit> units77, expected77;
+    vector<Lz78OutputUnit> units78, expected78;
+    vector<LzWOutputUnit> unitsW, expectedW;
+    vector<char> out, expected;
+
+    // 第一轮预热并检查结果，第二轮检查内存分配
+    for (int round = 0; round < 2; round++) {
+        size_t allocs = allocCount;
+        for (int i = 0; i < N_MESSAGES; i++) {
+            const char *msg = src.data() + offsets[i];
+            int len = lens[i];
+            for (Lz77Context *ctx : {&chain77, &tree77}) {
+                units77.clear();
+                out.clear();
+                ctx->compress(msg, len, units77);
+                if (ctx->decompress(units77.data(), units77.size(), out) != len || memcmp(out.data(), msg, len))
+                    return false;
+            }
+            units78.clear();
+            out.clear();
+            ctx78.compress(msg, len, units78);
+            if (ctx78.decompress(units78.data(), units78.size(), out) != len || memcmp(out.data(), msg, len))
+                return false;
+            unitsW.clear();
+            out.clear();
+            ctxW.compress(msg, len, unitsW);
+            if (ctxW.decompress(unitsW.data(), unitsW.size(), out) != len || memcmp(out.data(), msg, len))
+                return false;
+
+            if (round == 0) {
+                vector<char> part(msg, msg + len);
+                expected77.clear();
+                expected78.clear();
+                expectedW.clear();
+                compressLz77(part, expected77, searchBufLen, lookAheadBufLen, tree);
+                compressLz78(part, expected78, dictSize);
+                compressLzW(part, expectedW, dictSize);
+                // units77此时是二叉树查找器的结果
+                if (units77.size() != expected77.size() || units78.size() != expected78.size() || unitsW.size() != expectedW.size())
+                    return false;
+                for (int j = 0; j < units77.size(); j++)
+                    if (units77[j].offset != expected77[j].offset || units77[j].length != expected77[j].length)
+                        return false;
+                for (int j = 0; j < units78.size(); j++)
+                    if (units78[j].index != expected78[j].index)
+                        return false;
+                for (int j = 0; j < unitsW.size(); j++)
+                    if (unitsW[j].index != expectedW[j].index)
+                        return false;
+            }
+        }
+        // 第一轮中各vector已增长到最大长度，第二轮不应再分配
+        if (round == 1 && allocCount != allocs)
+            return false;
+    }
+    return true;
+}
+
 int main(int argc, char* argv[]) {
     parse_arg(argc, argv);
 
-    time_t time_lz77 = 0, time_lz77_parall = 0, time_lz78 = 0, time_lzw = 0;
+    // 各项的墙钟时间（纳秒），每项包括压缩与解压，详细的吞吐量见bench.cpp
+    long long time_lz77 = 0, time_lz77_parall = 0, time_lz78 = 0, time_lzw = 0;
+    long long time_lz77_brute = 0, time_lz77_bt = 0, time_unused = 0;
 
     // TODO: 压缩率测试
 
@@ -207,12 +848,77 @@ int main(int argc, char* argv[]) {
 
         bool flag;
 
+        printf("Test %d for MatchLength...", test);
+        flag = test_match_length();
+        printf(flag ? " Passed.\n" : "Failed.\n");
+
         printf("Test %d for LZ77...", test);
         flag = test_lz77(src, searchBufLen, lookAheadBufLen, time_lz77);
         printf(flag ? " Passed.\n" : "Failed.\n");
 
+        // 能找到最长匹配的查找方式应与穷举查找输出同样多的三元组，在只含4种符号的输入上也检查一遍，以产生较长的匹配
+        vector<char> lowSrc(src);
+        for (char &c : lowSrc) c &= 3;
+        for (const vector<char> *in : {&src, &lowSrc}) {
+            Lz77Options brute, chain, tree;
+            brute.matchFinder = LZ77_MF_BRUTE;
+            chain.matchFinder = LZ77_MF_HASH_CHAIN;
+            chain.chainDepth = searchBufLen;
+            tree.matchFinder = LZ77_MF_BINARY_TREE;
+            vector<Lz77OutputUnit> expected;
+            long long start = wall_ns();
+            int expectedUnits = compressLz77(*in, expected, searchBufLen, lookAheadBufLen, brute);
+            time_lz77_brute += wall_ns() - start;
+
+            const char *inputName = in == &src ? "random" : "low-entropy";
+            printf("Test %d for LZ77_HashChain(%s)...", test, inputName);
+            flag = test_lz77_match_finder(*in, searchBufLen, lookAheadBufLen, chain, expectedUnits, time_unused);
+            printf(flag ? " Passed.\n" : "Failed.\n");
+
+            printf("Test %d for LZ77_BinaryTree(%s)...", test, inputName);
+            flag = test_lz77_match_finder(*in, searchBufLen, lookAheadBufLen, tree, expectedUnits, time_lz77_bt);
+            printf(flag ? " Passed.\n" : "Failed.\n");
+        }
+
+        printf("Test %d for LZ77_Buffer...", test);
+        flag = test_lz77_buffer(src, searchBufLen, lookAheadBufLen)
+            && test_lz77_buffer(lowSrc, searchBufLen, lookAheadBufLen);
+        printf(flag ? " Passed.\n" : "Failed.\n");
+
+        printf("Test %d for LZ77_Stream...", test);
+        flag = true;
+        for (int matchFinder : {LZ77_MF_HASH_CHAIN, LZ77_MF_BINARY_TREE}) {
+            Lz77Options options;
+            options.matchFinder = matchFinder;
+            flag = flag && test_lz77_stream(src, searchBufLen, lookAheadBufLen, options)
+                && test_lz77_stream(lowSrc, searchBufLen, lookAheadBufLen, options);
+        }
+        printf(flag ? " Passed.\n" : "Failed.\n");
+
+        // 各压缩等级的输出都能解压，流式压缩与整块压缩相同
+        printf("Test %d for LZ77_Level...", test);
+        flag = true;
+        for (int level = 1; level <= 9; level++)
+            flag = flag && test_lz77_stream(src, searchBufLen, lookAheadBufLen, lz77Level(level))
+                && test_lz77_stream(lowSrc, searchBufLen, lookAheadBufLen, lz77Level(level));
+        printf(flag ? " Passed.\n" : "Failed.\n");
+
+        printf("Test %d for LZ77_Huffman...", test);
+        flag = test_huffman_lz77(src, searchBufLen, lookAheadBufLen)
+            && test_huffman_lz77(lowSrc, searchBufLen, lookAheadBufLen);
+        printf(flag ? " Passed.\n" : "Failed.\n");
+
         printf("Test %d for LZ77_Parallel...", test);
-        flag = test_lz77_parallel(N_THREAD, src, searchBufLen, lookAheadBufLen, time_lz77_parall);
+        flag = test_lz77_parallel(N_THREAD, src, searchBufLen, lookAheadBufLen, 1 << 20, true, time_lz77_parall)
+            && test_lz77_parallel(N_THREAD + 1, src, searchBufLen, lookAheadBufLen, rrand(100000, 90000), true, time_unused)
+            && test_lz77_parallel(N_THREAD + 1, lowSrc, searchBufLen, lookAheadBufLen, rrand(1000, 900), true, time_unused)
+            && test_lz77_parallel(N_THREAD + 1, src, searchBufLen, lookAheadBufLen, rrand(100000, 90000), false, time_unused)
+            && test_shared_pool(N_THREAD, lowSrc, searchBufLen, lookAheadBufLen);
+        printf(flag ? " Passed.\n" : "Failed.\n");
+
+        printf("Test %d for Context...", test);
+        flag = test_context(src, searchBufLen, lookAheadBufLen, dictSize)
+            && test_context(lowSrc, searchBufLen, lookAheadBufLen, 1 << 17);
         printf(flag ? " Passed.\n" : "Failed.\n");
 
         printf("Test %d for LZ78...", test);
@@ -222,12 +928,83 @@ int main(int argc, char* argv[]) {
         printf("Test %d for LZW...", test);
         flag = test_lzw(src, dictSize, time_lzw);
         printf(flag ? " Passed.\n" : "Failed.\n");
+
+        printf("Test %d for PhraseDecode...", test);
+        flag = test_phrase_decode();
+        printf(flag ? " Passed.\n" : "Failed.\n");
+
+        // 随机字节输入使字典很快超过16位下标的范围
+        vector<char> bytes(rrand(200000, 100000));
+        for (char &c : bytes) c = rand();
+        printf("Test %d for LZ78_Pack...", test);
+        flag = test_pack<Lz78OutputUnit>(src, dictSize, compressLz78, decompressLz78, packLz78, unpackLz78)
+            && test_pack<Lz78OutputUnit>(bytes, 1 << 17, compressLz78, decompressLz78, packLz78, unpackLz78);
+        printf(flag ? " Passed.\n" : "Failed.\n");
+
+        printf("Test %d for LZW_Pack...", test);
+        flag = test_pack<LzWOutputUnit>(src, dictSize, compressLzW, decompressLzW, packLzW, unpackLzW)
+            && test_pack<LzWOutputUnit>(bytes, 1 << 17, compressLzW, decompressLzW, packLzW, unpackLzW)
+            && test_pack<LzWOutputUnit>(bytes, 2, compressLzW, decompressLzW, packLzW, unpackLzW);
+        printf(flag ? " Passed.\n" : "Failed.\n");
+
+        printf("Test %d for LZ78_Parallel...", test);
+        flag = test_lz_blocks(N_THREAD + 1, src, dictSize, rrand(100000, 90000), parallel_compressLz78, parallel_decompressLz78)
+            && test_lz_blocks(N_THREAD + 1, lowSrc, dictSize, rrand(1000, 900), parallel_compressLz78, parallel_decompressLz78);
+        printf(flag ? " Passed.\n" : "Failed.\n");
+
+        printf("Test %d for CRC32C...", test);
+        flag = test_crc32c(src);
+        printf(flag ? " Passed.\n" : "Failed.\n");
+
+        printf("Test %d for Container...", test);
+        flag = test_container(N_THREAD, src, CODEC_LZ77, searchBufLen, lookAheadBufLen, dictSize, rrand(100000, 90000))
+            && test_container(N_THREAD, lowSrc, CODEC_LZ78, searchBufLen, lookAheadBufLen, dictSize, rrand(10000, 9000))
+            && test_container(N_THREAD + 1, src, CODEC_LZW, searchBufLen, lookAheadBufLen, dictSize, rrand(10000, 9000));
+        printf(flag ? " Passed.\n" : "Failed.\n");
+
+        printf("Test %d for Stored...", test);
+        flag = test_stored(src, lowSrc);
+        printf(flag ? " Passed.\n" : "Failed.\n");
+
+        printf("Test %d for LongDistance...", test);
+        flag = test_long(src, lowSrc, searchBufLen, lookAheadBufLen);
+        printf(flag ? " Passed.\n" : "Failed.\n");
+
+        printf("Test %d for Dictionary...", test);
+        flag = test_dictionary(searchBufLen, lookAheadBufLen, dictSize);
+        printf(flag ? " Passed.\n" : "Failed.\n");
+
+        printf("Test %d for Pipeline...", test);
+        flag = test_pipeline(N_THREAD, src, CODEC_LZ77, searchBufLen, lookAheadBufLen, dictSize, rrand(100000, 90000))
+            && test_pipeline(N_THREAD, lowSrc, CODEC_LZ78, searchBufLen, lookAheadBufLen, dictSize, rrand(1000, 900))
+            && test_pipeline(N_THREAD + 1, src, CODEC_LZW, searchBufLen, lookAheadBufLen, dictSize, rrand(10000, 9000));
+        printf(flag ? " Passed.\n" : "Failed.\n");
+
+        printf("Test %d for LZ78_ParallelDecode...", test);
+        flag = test_lz78_parallel_decode(N_THREAD + 1, src, dictSize)
+            && test_lz78_parallel_decode(N_THREAD + 1, lowSrc, dictSize)
+            && test_lz78_parallel_decode(N_THREAD + 1, bytes, 1 << 17);
+        printf(flag ? " Passed.\n" : "Failed.\n");
+
+        printf("Test %d for LZW_Parallel...", test);
+        flag = test_lz_blocks(N_THREAD + 1, src, dictSize, rrand(100000, 90000), parallel_compressLzW, parallel_decompressLzW)
+            && test_lz_blocks(N_THREAD + 1, lowSrc, dictSize, rrand(1000, 900), parallel_compressLzW, parallel_decompressLzW);
+        printf(flag ? " Passed.\n" : "Failed.\n");
+
+#ifdef LZ_STATS
+        printf("Test %d for Stats...", test);
+        flag = test_stats(src, searchBufLen, lookAheadBufLen, dictSize)
+            && test_stats(lowSrc, searchBufLen, lookAheadBufLen, dictSize);
+        printf(flag ? " Passed.\n" : "Failed.\n");
+#endif
     }
 
-    printf("LZ77:       %lld ms\n", time_lz77 * 1000 / CLOCKS_PER_SEC / NUM_TESTS);
-    printf("Multi-core: %lld ms\n", time_lz77_parall * 1000 / CLOCKS_PER_SEC / NUM_TESTS);
-    printf("LZ78:       %lld ms\n", time_lz78 * 1000 / CLOCKS_PER_SEC / NUM_TESTS);
-    printf("LZW:        %lld ms\n", time_lzw * 1000 / CLOCKS_PER_SEC / NUM_TESTS);
+    printf("LZ77:       %lld ms\n", time_lz77 / 1000000 / NUM_TESTS);
+    printf("LZ77 brute: %lld ms (compress only)\n", time_lz77_brute / 1000000 / NUM_TESTS);
+    printf("LZ77 BT:    %lld ms (compress only)\n", time_lz77_bt / 1000000 / NUM_TESTS);
+    printf("Multi-core: %lld ms\n", time_lz77_parall / 1000000 / NUM_TESTS);
+    printf("LZ78:       %lld ms\n", time_lz78 / 1000000 / NUM_TESTS);
+    printf("LZW:        %lld ms\n", time_lzw / 1000000 / NUM_TESTS);
 
     return 0;
 }
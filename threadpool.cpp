@@ -0,0 +1,123 @@
+#include "threadpool.h"
+
+struct WorkerStart {
+    ThreadPool *pool;
+    int worker;
+};
+
+ThreadPool::ThreadPool(int nThreads)
+        : nThreads(nThreads > 0 ? nThreads : 1), ranges(this->nThreads), generation(0), running(0), stop(false) {
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&startCond, NULL);
+    pthread_cond_init(&doneCond, NULL);
+    pthread_mutex_init(&jobLock, NULL);
+    for (Range &r : ranges) {
+        r.next = 0;
+        r.end = 0;
+    }
+    // 编号0留给调用parallelFor的线程
+    for (int i = 1; i < this->nThreads; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, workerMain, new WorkerStart{this, i}))
+            break; // 创建失败时以已有的线程继续工作，其区间会被其他线程取走
+        threads.push_back(thread);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    pthread_mutex_lock(&lock);
+    stop = true;
+    pthread_cond_broadcast(&startCond);
+    pthread_mutex_unlock(&lock);
+    for (pthread_t thread : threads)
+        pthread_join(thread, NULL);
+    pthread_mutex_destroy(&lock);
+    pthread_cond_destroy(&startCond);
+    pthread_cond_destroy(&doneCond);
+    pthread_mutex_destroy(&jobLock);
+}
+
+void *ThreadPool::workerMain(void *arg) {
+    WorkerStart start = *(WorkerStart *)arg;
+    delete (WorkerStart *)arg;
+    ThreadPool *pool = start.pool;
+
+    long long seen = 0; // 已执行过的任务编号
+    while (true) {
+        pthread_mutex_lock(&pool->lock);
+        while (!pool->stop && pool->generation == seen)
+            pthread_cond_wait(&pool->startCond, &pool->lock);
+        if (pool->stop) {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        pool->run(start.worker);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->running == 0)
+            pthread_cond_signal(&pool->doneCond);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+/*
+ * 先取自己区间中的下标，取完后依次从其他线程的区间中取，所有区间都取完时返回。
+ */
+void ThreadPool::run(int worker) {
+    for (int k = 0; k < nThreads; k++) {
+        Range &r = ranges[(worker + k) % nThreads];
+        for (int i; (i = r.next.fetch_add(1, std::memory_order_relaxed)) < r.end; )
+            fn(arg, i, worker);
+    }
+}
+
+void ThreadPool::parallelFor(int n, Task fn, void *arg) {
+    if (n <= 0)
+        return;
+    if (threads.empty() || n == 1) {
+        for (int i = 0; i < n; i++)
+            fn(arg, i, 0);
+        return;
+    }
+
+    pthread_mutex_lock(&jobLock);
+    // 下标均分为nThreads段，每段连续，使相邻的块尽量由同一线程处理
+    for (int t = 0; t < nThreads; t++) {
+        ranges[t].next.store((long long)n * t / nThreads, std::memory_order_relaxed);
+        ranges[t].end = (long long)n * (t + 1) / nThreads;
+    }
+    pthread_mutex_lock(&lock);
+    this->fn = fn;
+    this->arg = arg;
+    running = threads.size();
+    generation++;
+    pthread_cond_broadcast(&startCond);
+    pthread_mutex_unlock(&lock);
+
+    run(0);
+
+    pthread_mutex_lock(&lock);
+    while (running > 0)
+        pthread_cond_wait(&doneCond, &lock);
+    pthread_mutex_unlock(&lock);
+    pthread_mutex_unlock(&jobLock);
+}
+
+ThreadPool &ThreadPool::shared(int nThreads) {
+    // 每种线程数一个线程池，创建后不再释放：其他线程可能仍在旧线程池上执行parallelFor
+    static pthread_mutex_t sharedLock = PTHREAD_MUTEX_INITIALIZER;
+    static std::vector<ThreadPool *> pools; // pools[n]为n个线程的线程池
+    if (nThreads < 1)
+        nThreads = 1;
+    pthread_mutex_lock(&sharedLock);
+    if ((int)pools.size() <= nThreads)
+        pools.resize(nThreads + 1, NULL);
+    if (!pools[nThreads])
+        pools[nThreads] = new ThreadPool(nThreads);
+    ThreadPool &result = *pools[nThreads];
+    pthread_mutex_unlock(&sharedLock);
+    return result;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <atomic>
+#include <pthread.h>
+#include <vector>
+
+/*
+ * 常驻线程池
+ *
+ * 工作线程在创建后一直等待任务，避免每次并行压缩都创建、回收线程。
+ * 一个任务是对下标0..n-1各调用一次的函数，调用parallelFor的线程也参与执行。
+ * 下标预先按线程均分为连续的区间，每个线程从自己区间的头部取下标；自己的区间取完后，
+ * 再从其他线程的区间中取（work stealing），因此个别块耗时较长时不会让其余线程空等。
+ */
+class ThreadPool {
+public:
+    /*
+     * 执行单个下标的函数。
+     *
+     * Params:
+     *     arg : parallelFor传入的参数。
+     *     i : 下标。
+     *     worker : 执行线程的编号，取值为0..size()-1，同一时刻不会有两个线程使用同一编号，可用于索引线程私有的数据。
+     */
+    typedef void (*Task)(void *arg, int i, int worker);
+
+    /*
+     * 创建含nThreads个线程（包括调用parallelFor的线程）的线程池。
+     */
+    explicit ThreadPool(int nThreads);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /*
+     * 对i = 0..n-1并行调用fn(arg, i, worker)，全部完成后返回。多个线程同时调用时依次执行。
+     */
+    void parallelFor(int n, Task fn, void *arg);
+
+    int size() const { return nThreads; }
+
+    /*
+     * 返回进程内共享的、含nThreads个线程的线程池。每种线程数的线程池在第一次使用时创建，此后一直保留，
+     * 以不同线程数调用不会释放其他调用者正在使用的线程池。
+     */
+    static ThreadPool &shared(int nThreads);
+
+private:
+    struct alignas(64) Range { // 独占缓存行，避免不同线程的计数器互相干扰
+        std::atomic<int> next; // 下一个待执行的下标，任何线程都可以取
+        int end;
+    };
+
+    static void *workerMain(void *arg);
+    void run(int worker);
+
+    int nThreads;
+    std::vector<pthread_t> threads;
+    std::vector<Range> ranges; // 各线程的下标区间
+
+    pthread_mutex_t lock;
+    pthread_cond_t startCond; // 有新任务或要退出
+    pthread_cond_t doneCond;  // 工作线程都已完成当前任务
+    pthread_mutex_t jobLock;  // 保证同一时刻只有一个任务
+    long long generation;     // 任务编号，每提交一个任务加1
+    int running;              // 尚未完成当前任务的工作线程个数
+    bool stop;
+    Task fn;
+    void *arg;
+};
@@ -0,0 +1,90 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "dict.h"
+#include "fileio.h"
+
+/*
+ * 预置字典训练工具
+ *
+ * 每个样本文件是一条样本；加上--lines时，文件中的每一行是一条样本（如每行一条JSON消息的日志）。
+ * 训练得到的字典原样写入输出文件，压缩与解压时以main.exe --dict <dict_file>载入。
+ */
+
+using namespace std;
+
+#define putline(x) printf("%s\n", x)
+
+int dict_capacity = 16 << 10; // 字典的最大长度
+int segment_len = 64;         // 每次选出的片段长度
+bool split_lines = false;     // 按行拆分样本
+const char *output_file = NULL;
+vector<const char *> sample_files;
+
+void show_usage() {
+    putline("Usage: train -o <dict_file> [--size <bytes>] [--seg <segmentLen>] [--lines] <sample_file>...");
+    putline("--size        maximum dictionary size in bytes. (16384)");
+    putline("--seg         length of each selected segment. (64)");
+    putline("--lines       treat each line of a sample file as a separate sample.");
+}
+
+void unknown_arg_err() {
+    putline("Unknown argument error");
+    show_usage();
+    exit(-1);
+}
+
+void parse_arg(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        char *arg = argv[i];
+        if (!strcmp(arg, "-o") && i + 1 < argc) output_file = argv[++i];
+        else if (!strcmp(arg, "--size") && i + 1 < argc) dict_capacity = atoi(argv[++i]);
+        else if (!strcmp(arg, "--seg") && i + 1 < argc) segment_len = atoi(argv[++i]);
+        else if (!strcmp(arg, "--lines")) split_lines = true;
+        else if (!strcmp(arg, "-h") || !strcmp(arg, "--help")) {
+            show_usage();
+            exit(0);
+        }
+        else if (arg[0] == '-') unknown_arg_err();
+        else sample_files.push_back(arg);
+    }
+    if (!output_file || sample_files.empty()) {
+        show_usage();
+        exit(-1);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    parse_arg(argc, argv);
+
+    vector<vector<char>> samples;
+    size_t total = 0;
+    for (const char *path : sample_files) {
+        MappedFile file;
+        if (!file.open(path)) {
+            printf("Cannot open %s\n", path);
+            return 1;
+        }
+        const char *p = file.data(), *end = p + file.size();
+        while (p < end) {
+            const char *next = split_lines ? (const char *)memchr(p, '\n', end - p) : NULL;
+            next = next ? next + 1 : end;
+            samples.emplace_back(p, next);
+            total += next - p;
+            p = next;
+        }
+    }
+
+    vector<char> dict;
+    trainDictionary(samples, dict_capacity, dict, segment_len);
+    OutputFile out;
+    if (!out.open(output_file) || !out.write(dict.data(), dict.size()) || !out.close()) {
+        printf("Cannot write %s\n", output_file);
+        return 1;
+    }
+    printf("%zu samples, %zu bytes -> dictionary of %zu bytes\n", samples.size(), total, dict.size());
+    return 0;
+}
@@ -0,0 +1,239 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#define N_SYMBOLS 256
+
+typedef unsigned char sym_t;
+
+/*
+ * LZ78/LZW共用的字典树
+ *
+ * 字典树的节点按加入顺序编号，编号即字典下标，根节点为0。两种实现接口相同：
+ *     init(capacity)     : 清空并预留capacity个节点的空间，之后树中只有根节点。
+ *                          capacity与上次相同时只撤销上次加入的节点，代价与加入的节点数成正比，不重新分配内存。
+ *     rollback(size)     : 按加入的逆序撤销编号不小于size的节点，之后的状态与加入它们之前相同。
+ *                          预置字典（见dict.h）以此把字典建立的树当作快照，每次压缩后只撤销新加入的节点。
+ *     find(node, c)      : 返回node经符号c到达的子节点，不存在时返回-1。
+ *     add(parent, c)     : 加入一个新节点并返回其编号，之后可以通过find找到它。
+ *     append(parent, c)  : 同add，但只记录parent与symbol，不建立查找索引。解压时只需沿parent回溯，用它即可。
+ *     parent(node), symbol(node), size()
+ * 默认使用HashTrie；编译时定义LZ_TRIE_DENSE则使用DenseTrie。
+ */
+
+/*
+ * 字典树节点
+ *
+ * 在预先开辟的数组上实现字典树。数组相当于内存，int型数组下标相当于指针。
+ */
+template <int N>
+struct Node {
+    int parent; // 父节点指针，这一字段在压缩时不会用到
+    sym_t symbol; // 从父节点到当前节点的边上的符号。尽管这一字段可以从父节点计算得到，但保存在此效率更高。这一字段在压缩时不会用到
+    int child[N]; // 各子节点指针，去往第i个子节点的边上符号为i
+};
+
+/*
+ * 稠密字典树：每个节点保存全部N_SYMBOLS个子节点指针，查找只需一次数组访问，但每个节点占用1 KB以上。
+ */
+class DenseTrie {
+public:
+    void init(int capacity) {
+        if (capacity < 1)
+            capacity = 1;
+        if (nodes.size() == (size_t)capacity) {
+            rollback(1);
+        } else {
+            nodes.resize(capacity);
+            memset(nodes.data(), -1, sizeof(Node<N_SYMBOLS>) * nodes.size()); // 全部指针初始化为-1，表示空指针
+            count = 1;
+        }
+    }
+
+    void rollback(int size) {
+        // 每个节点的指针只保存在其父节点中，逐个清除即可。只由append加入的节点不在父节点中，不会误清
+        for (int node = count - 1; node >= size; node--) {
+            int &child = nodes[nodes[node].parent].child[nodes[node].symbol];
+            if (child == node)
+                child = -1;
+        }
+        count = size;
+    }
+
+    int find(int node, sym_t c) const { return nodes[node].child[c]; }
+
+    int add(int parent, sym_t c) {
+        int node = append(parent, c);
+        nodes[parent].child[c] = node;
+        return node;
+    }
+
+    int append(int parent, sym_t c) {
+        int node = count++;
+        nodes[node].parent = parent;
+        nodes[node].symbol = c;
+        return node;
+    }
+
+    int parent(int node) const { return nodes[node].parent; }
+    sym_t symbol(int node) const { return nodes[node].symbol; }
+    int size() const { return count; }
+
+private:
+    std::vector<Node<N_SYMBOLS>> nodes;
+    int count; // 节点个数
+};
+
+/*
+ * 紧凑字典树：以(父节点, 符号)为键的开放寻址哈希表。
+ *
+ * 哈希表的每一项保存父节点与子节点编号（8字节），装载因子不超过1/2。父节点不同的项在表内即可排除，
+ * 只有父节点相同时才需要到symbols中核对符号。每个节点共占约20字节，字典大小为32767时约0.6 MB。
+ * 每个短语都从根节点开始匹配，因此根节点的子节点单独用一张直接索引的表保存。
+ */
+class HashTrie {
+public:
+    void init(int capacity) {
+        if (capacity < 1)
+            capacity = 1;
+        if (parents.size() == (size_t)capacity) {
+            rollback(1);
+            return;
+        }
+        bits = 1;
+        while ((1 << bits) < capacity * 2)
+            bits++;
+        slots.assign((size_t)1 << bits, Slot{-1, -1});
+        memset(rootChildren, -1, sizeof(rootChildren));
+        parents.resize(capacity);
+        symbols.resize(capacity);
+        parents[0] = -1;
+        symbols[0] = 0;
+        count = 1;
+    }
+
+    int find(int node, sym_t c) const {
+        if (node == 0)
+            return rootChildren[c];
+        size_t mask = slots.size() - 1;
+        for (size_t h = hash(node, c); ; h = (h + 1) & mask) {
+            const Slot &slot = slots[h];
+            if (slot.child < 0 || (slot.parent == node && symbols[slot.child] == c))
+                return slot.child;
+        }
+    }
+
+    int add(int parent, sym_t c) {
+        int node = append(parent, c);
+        if (parent == 0) {
+            rootChildren[c] = node;
+            return node;
+        }
+        size_t mask = slots.size() - 1;
+        size_t h = hash(parent, c);
+        while (slots[h].child >= 0)
+            h = (h + 1) & mask;
+        slots[h] = Slot{parent, node};
+        return node;
+    }
+
+    int append(int parent, sym_t c) {
+        int node = count++;
+        parents[node] = parent;
+        symbols[node] = c;
+        return node;
+    }
+
+    /*
+     * 按加入的逆序从哈希表中删除节点。线性探测下，逆序删除恰好还原每个节点加入前的状态，
+     * 因此每个节点的探测路径在删除它时仍然完整，不需要墓碑标记。只由append加入的节点在表中找不到，直接跳过。
+     */
+    void rollback(int size) {
+        size_t mask = slots.size() - 1;
+        for (int node = count - 1; node >= size; node--) {
+            if (parents[node] == 0) {
+                if (rootChildren[symbols[node]] == node)
+                    rootChildren[symbols[node]] = -1;
+                continue;
+            }
+            for (size_t h = hash(parents[node], symbols[node]); slots[h].child >= 0; h = (h + 1) & mask) {
+                if (slots[h].child == node) {
+                    slots[h] = Slot{-1, -1};
+                    break;
+                }
+            }
+        }
+        count = size;
+    }
+
+    int parent(int node) const { return parents[node]; }
+    sym_t symbol(int node) const { return symbols[node]; }
+    int size() const { return count; }
+
+private:
+
+    struct Slot {
+        int32_t parent;
+        int32_t child; // -1表示空
+    };
+
+    size_t hash(int node, sym_t c) const {
+        return (((uint64_t)(uint32_t)node << 8 | c) * 0x9E3779B97F4A7C15ull) >> (64 - bits);
+    }
+
+    int32_t rootChildren[N_SYMBOLS]; // 根节点的子节点，每个短语都从根节点开始匹配，直接查表
+    std::vector<Slot> slots;      // 哈希表，保存根节点以外的节点
+    std::vector<int32_t> parents; // 各节点的父节点
+    std::vector<sym_t> symbols;   // 从父节点到各节点的边上的符号
+    int bits;                     // 哈希表大小为2^bits
+    int count;                    // 节点个数
+};
+
+/*
+ * 解压用的短语表
+ *
+ * 第k项记录字典中第k个短语在本次解压输出中首次出现的位置与长度。字典的项只追加、不替换，
+ * 因此记录的位置一直有效，解压一个单元只需从已输出的数据中复制一次，不必沿parent逐个符号回溯再逆转。
+ * 位置与长度相邻存放，取一项只访问一次内存。
+ */
+class PhraseTable {
+public:
+    /*
+     * 清空并预留capacity项的空间。
+     */
+    void init(int capacity) {
+        if (entries.size() < (size_t)capacity)
+            entries.resize(capacity);
+        count = 0;
+    }
+
+    int add(int offset, int length) {
+        entries[count] = Entry{offset, length};
+        return count++;
+    }
+
+    /*
+     * 只保留前size项。
+     */
+    void rollback(int size) { count = size; }
+
+    int offset(int k) const { return entries[k].offset; }
+    int length(int k) const { return entries[k].length; }
+    int size() const { return count; }
+
+private:
+    struct Entry {
+        int32_t offset; // 在输出中的起始位置
+        int32_t length;
+    };
+
+    std::vector<Entry> entries;
+    int count; // 项数
+};
+
+#ifdef LZ_TRIE_DENSE
+typedef DenseTrie Trie;
+#else
+typedef HashTrie Trie;
+#endif